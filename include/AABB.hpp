@@ -0,0 +1,65 @@
+#pragma once
+
+#include "global.hpp"
+
+// 轴对齐包围盒
+struct AABB {
+    Vector3f min_p;
+    Vector3f max_p;
+
+    // 默认构造为空盒（min > max），expand 之后才有效
+    AABB()
+        : min_p( std::numeric_limits<float>::max()),
+          max_p(-std::numeric_limits<float>::max()) {}
+    AABB(const Vector3f& a, const Vector3f& b) : min_p(a), max_p(b) {}
+
+    void expand(const Vector3f& p) {
+        min_p.x = std::min(min_p.x, p.x);
+        min_p.y = std::min(min_p.y, p.y);
+        min_p.z = std::min(min_p.z, p.z);
+        max_p.x = std::max(max_p.x, p.x);
+        max_p.y = std::max(max_p.y, p.y);
+        max_p.z = std::max(max_p.z, p.z);
+    }
+
+    // 逐分量取 min/max，空盒与任何盒合并都不改变结果
+    void expand(const AABB& b) {
+        min_p.x = std::min(min_p.x, b.min_p.x);
+        min_p.y = std::min(min_p.y, b.min_p.y);
+        min_p.z = std::min(min_p.z, b.min_p.z);
+        max_p.x = std::max(max_p.x, b.max_p.x);
+        max_p.y = std::max(max_p.y, b.max_p.y);
+        max_p.z = std::max(max_p.z, b.max_p.z);
+    }
+
+    bool valid() const {
+        return min_p.x <= max_p.x && min_p.y <= max_p.y && min_p.z <= max_p.z;
+    }
+
+    Vector3f centroid() const {
+        return (min_p + max_p) * 0.5f;
+    }
+
+    Vector3f extent() const {
+        return max_p - min_p;
+    }
+
+    // 表面积（SAH 代价用）
+    float surfaceArea() const {
+        if (!valid()) return 0.0f;
+        Vector3f d = extent();
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    // 最长轴：0=x, 1=y, 2=z
+    int maxExtentAxis() const {
+        Vector3f d = extent();
+        if (d.x > d.y && d.x > d.z) return 0;
+        return (d.y > d.z) ? 1 : 2;
+    }
+};
+
+// 按下标取分量（0=x, 1=y, 2=z）
+inline float axisOf(const Vector3f& v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "global.hpp"
+
+// Walker/Vose 别名表：按权重离散采样，构建 O(n)，采样 O(1) 且不分配内存
+class AliasTable {
+public:
+    void build(const std::vector<float>& weights) {
+        size_t n = weights.size();
+        prob.assign(n, 1.0f);
+        alias.assign(n, 0);
+        pmf.assign(n, 0.0f);
+        total = 0.0f;
+
+        for (float w : weights) total += std::max(0.0f, w);
+        if (n == 0 || total <= 0.0f) {
+            prob.clear();
+            alias.clear();
+            pmf.clear();
+            return;
+        }
+
+        // 把每个权重缩放到均值为 1，然后分成小于 1 和不小于 1 的两组
+        std::vector<float> scaled(n);
+        std::vector<uint32_t> small, large;
+        small.reserve(n);
+        large.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            pmf[i] = std::max(0.0f, weights[i]) / total;
+            scaled[i] = pmf[i] * static_cast<float>(n);
+            if (scaled[i] < 1.0f) small.push_back(static_cast<uint32_t>(i));
+            else                  large.push_back(static_cast<uint32_t>(i));
+        }
+
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back(); small.pop_back();
+            uint32_t l = large.back();
+
+            prob[s] = scaled[s];
+            alias[s] = l;
+
+            scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+            if (scaled[l] < 1.0f) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // 剩下的（含浮点误差造成的）都是概率 1
+        for (uint32_t i : large) { prob[i] = 1.0f; alias[i] = i; }
+        for (uint32_t i : small) { prob[i] = 1.0f; alias[i] = i; }
+    }
+
+    // u ∈ [0,1)：整数部分选格子，小数部分决定取自己还是别名
+    uint32_t sample(float u) const {
+        size_t n = prob.size();
+        float scaled = u * static_cast<float>(n);
+        uint32_t i = std::min(static_cast<uint32_t>(scaled), static_cast<uint32_t>(n - 1));
+        float frac = scaled - static_cast<float>(i);
+        return (frac < prob[i]) ? i : alias[i];
+    }
+
+    // 选中第 i 项的概率
+    float pmfOf(uint32_t i) const { return pmf[i]; }
+
+    float totalWeight() const { return total; }
+    size_t size() const { return prob.size(); }
+    bool empty() const { return prob.empty(); }
+
+private:
+    std::vector<float> prob;
+    std::vector<uint32_t> alias;
+    std::vector<float> pmf;
+    float total = 0.0f;
+};
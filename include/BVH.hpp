@@ -0,0 +1,679 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include "AABB.hpp"
+#include "Buffer.hpp"
+#include "RayPacket.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
+
+// BVH 节点（32 字节，深度优先存放：左孩子紧跟在父节点后面）
+struct BVHNode {
+    AABB bounds;
+    uint32_t offset;  // 内部节点：右孩子下标；叶子：首个图元在 prim_indices 中的位置
+    uint16_t count;   // 叶子中的图元个数，0 表示内部节点
+    uint16_t axis;    // 划分轴
+
+    bool isLeaf() const { return count > 0; }
+};
+
+// 射线 - AABB 相交（slab 方法），返回进入距离 t_near
+// inv_dir 为方向分量的倒数；NaN 通过 std::max/min 的参数顺序被丢弃
+inline bool intersectAABB(const AABB& b, const Vector3f& org, const Vector3f& inv_dir,
+                          float t_max, float& t_near) {
+    float tx0 = (b.min_p.x - org.x) * inv_dir.x;
+    float tx1 = (b.max_p.x - org.x) * inv_dir.x;
+    float ty0 = (b.min_p.y - org.y) * inv_dir.y;
+    float ty1 = (b.max_p.y - org.y) * inv_dir.y;
+    float tz0 = (b.min_p.z - org.z) * inv_dir.z;
+    float tz1 = (b.max_p.z - org.z) * inv_dir.z;
+
+    float t0 = std::max(0.0f, std::min(tx0, tx1));
+    t0 = std::max(t0, std::min(ty0, ty1));
+    t0 = std::max(t0, std::min(tz0, tz1));
+    float t1 = std::min(t_max, std::max(tx0, tx1));
+    t1 = std::min(t1, std::max(ty0, ty1));
+    t1 = std::min(t1, std::max(tz0, tz1));
+
+    t_near = t0;
+    return t0 <= t1;
+}
+
+// BVH 的构建方式，从快到好：
+//   LBVH    质心的 Morton 码排序后按最高的不同位二分，最快，树的质量最差，适合交互预览
+//   Binned  每个节点在三个轴上各分 kBins 个桶找 SAH 最小的划分（默认）
+//   Sweep   大节点仍然分桶；图元数不超过 kSweepMaxPrims 的节点按每个轴排序，在所有位置上算 SAH
+enum class BVHQuality {
+    LBVH,
+    Binned,
+    Sweep
+};
+
+inline const char* bvhQualityName(BVHQuality quality) {
+    switch (quality) {
+        case BVHQuality::LBVH:   return "lbvh";
+        case BVHQuality::Binned: return "binned";
+        case BVHQuality::Sweep:  return "sweep";
+    }
+    return "unknown";
+}
+
+// 二叉 BVH，构建方式见 BVHQuality
+// 只负责组织图元下标，具体图元的求交由调用方通过回调提供
+class BVH {
+public:
+    static constexpr int kBins = 16;
+    static constexpr int kMaxLeafSize = 4;
+    static constexpr int kStackSize = 64;
+    static constexpr uint32_t kSweepMaxPrims = 1024;
+
+    // 给了 pool 就并行构建：大节点的包围盒和分桶按块并行统计，再往下左右子树作为任务并行
+    // 每个节点的划分只取决于它的图元，与线程数无关，所以同样的输入总是得到同一棵树
+    void build(const std::vector<AABB>& prim_bounds, BVHQuality quality = BVHQuality::Binned,
+               ThreadPool* pool = nullptr) {
+        nodes = Buffer<BVHNode>();
+        prim_indices = Buffer<uint32_t>();
+        if (prim_bounds.empty()) return;
+
+        const uint32_t n = static_cast<uint32_t>(prim_bounds.size());
+        BuildContext ctx{std::vector<BuildPrim>(n), quality, pool};
+        if (pool && pool->size() <= 1) ctx.pool = nullptr;
+        forChunks(ctx, 0, n, [&](uint32_t begin, uint32_t end, int) {
+            for (uint32_t i = begin; i < end; ++i) {
+                ctx.prims[i].bounds = prim_bounds[i];
+                ctx.prims[i].centroid = prim_bounds[i].centroid();
+                ctx.prims[i].index = i;
+            }
+        });
+        if (quality == BVHQuality::LBVH) sortByMorton(ctx);
+
+        std::vector<BVHNode> out;
+        out.reserve(2 * n);
+        buildNode(ctx, out, 0, n, 0);
+
+        std::vector<uint32_t> order(n);
+        forChunks(ctx, 0, n, [&](uint32_t begin, uint32_t end, int) {
+            for (uint32_t i = begin; i < end; ++i) order[i] = ctx.prims[i].index;
+        });
+        nodes = std::move(out);
+        prim_indices = std::move(order);
+    }
+
+    // 图元移动之后只重算包围盒，树的结构和图元顺序不变；prim_bounds 按原来的图元下标给出
+    // 移动幅度大时树的质量会变差，那时应该重新 build
+    void refit(const std::vector<AABB>& prim_bounds) {
+        if (nodes.empty()) return;
+        std::vector<BVHNode> out(nodes.begin(), nodes.end());
+        // 孩子的下标总比父节点大，倒着扫一遍即可
+        for (size_t i = out.size(); i-- > 0;) {
+            BVHNode& node = out[i];
+            AABB b;
+            if (node.isLeaf()) {
+                for (uint32_t k = 0; k < node.count; ++k) {
+                    b.expand(prim_bounds[prim_indices[node.offset + k]]);
+                }
+            } else {
+                b.expand(out[i + 1].bounds);
+                b.expand(out[node.offset].bounds);
+            }
+            node.bounds = b;
+        }
+        nodes = std::move(out);
+    }
+
+    // 树的 SAH 代价，按根节点表面积归一化；遍历和求交代价都记为 1，与构建时一致，越小越好
+    float sahCost() const {
+        if (nodes.empty()) return 0.0f;
+        const float root_area = nodes[0].bounds.surfaceArea();
+        if (root_area <= 0.0f) return 0.0f;
+        double cost = 0.0;
+        for (const BVHNode& node : nodes) {
+            const double area = node.bounds.surfaceArea();
+            cost += node.isLeaf() ? area * node.count : area;
+        }
+        return static_cast<float>(cost / root_area);
+    }
+
+    // 直接使用已经建好的节点和图元下标（例如从网格缓存里映射出来的）
+    void assign(Buffer<BVHNode> built_nodes, Buffer<uint32_t> built_prims) {
+        nodes = std::move(built_nodes);
+        prim_indices = std::move(built_prims);
+    }
+
+    // 最近交点遍历：近的孩子先访问，远的孩子入栈；出栈时若 t_near 已不小于 rec.t 则剪掉
+    // hitPrim(prim_index) 返回是否找到更近的交点，并负责缩小 rec.t
+    template <typename Record, typename PrimFn>
+    bool intersect(const Ray& ray, Record& rec, PrimFn&& hitPrim) const {
+        if (nodes.empty()) return false;
+
+        const Vector3f& org = ray.origin;
+        Vector3f inv_dir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        float t_root;
+        if (!intersectAABB(nodes[0].bounds, org, inv_dir, rec.t, t_root)) return false;
+
+        struct StackEntry {
+            uint32_t node;
+            float t_near;
+        };
+        StackEntry stack[kStackSize];
+        int sp = 0;
+
+        bool hit_anything = false;
+        uint32_t cur = 0;
+        while (true) {
+            const BVHNode& node = nodes[cur];
+            PT_STAT_ADD(kStatNodeVisits, 1);
+            if (node.isLeaf()) {
+                PT_STAT_ADD(kStatPrimTests, node.count);
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    if (hitPrim(prim_indices[node.offset + i])) {
+                        hit_anything = true;
+                    }
+                }
+            } else {
+                uint32_t left = cur + 1;
+                uint32_t right = node.offset;
+                float t_left, t_right;
+                bool hit_left = intersectAABB(nodes[left].bounds, org, inv_dir, rec.t, t_left);
+                bool hit_right = intersectAABB(nodes[right].bounds, org, inv_dir, rec.t, t_right);
+
+                if (hit_left && hit_right) {
+                    if (t_right < t_left) {
+                        std::swap(left, right);
+                        std::swap(t_left, t_right);
+                    }
+                    stack[sp++] = {right, t_right};
+                    cur = left;
+                    continue;
+                }
+                if (hit_left) { cur = left; continue; }
+                if (hit_right) { cur = right; continue; }
+            }
+
+            // 出栈，跳过已经比当前最近交点更远的节点
+            bool found = false;
+            while (sp > 0) {
+                const StackEntry& e = stack[--sp];
+                if (e.t_near < rec.t) {
+                    cur = e.node;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) break;
+        }
+        return hit_anything;
+    }
+
+    // 遮挡遍历：不需要最近交点，找到任意一个命中就立即返回
+    template <typename PrimFn>
+    bool occluded(const Ray& ray, float t_max, PrimFn&& hitPrim) const {
+        if (nodes.empty()) return false;
+
+        const Vector3f& org = ray.origin;
+        Vector3f inv_dir(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        uint32_t stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = 0;
+
+        while (sp > 0) {
+            const BVHNode& node = nodes[stack[--sp]];
+            float t_near;
+            if (!intersectAABB(node.bounds, org, inv_dir, t_max, t_near)) continue;
+
+            PT_STAT_ADD(kStatNodeVisits, 1);
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    PT_STAT_ADD(kStatPrimTests, 1);
+                    if (hitPrim(prim_indices[node.offset + i])) {
+                        return true;
+                    }
+                }
+            } else {
+                stack[sp++] = node.offset;
+                stack[sp++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            }
+        }
+        return false;
+    }
+
+    // 光线包遍历：一个节点与包内所有活跃射线同时求交，只要有一条命中就继续往下
+    // 近/远孩子的顺序按第一条活跃射线在划分轴上的方向决定（相干射线方向基本一致）
+    // hitPrim(prim_index, lane_mask) 对 mask 中的射线测试图元，并缩小 packet.t_max
+    template <typename PrimFn>
+    void intersectPacket(RayPacket& packet, PrimFn&& hitPrim) const {
+        if (nodes.empty() || !packet.active) return;
+
+        const int first = simd::firstLane(packet.active);
+        const bool negative[3] = {packet.dir[0][first] < 0.0f,
+                                  packet.dir[1][first] < 0.0f,
+                                  packet.dir[2][first] < 0.0f};
+
+        uint32_t stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = 0;
+
+        while (sp > 0) {
+            const uint32_t index = stack[--sp];
+            const BVHNode& node = nodes[index];
+            uint32_t mask = packet.intersectBox(node.bounds) & packet.active;
+            if (!mask) continue;
+
+            // 统计按射线计：节点对包里命中它的每条射线各算一次访问
+            PT_STAT_ADD(kStatNodeVisits, simd::popcount(mask));
+            if (node.isLeaf()) {
+                PT_STAT_ADD(kStatPrimTests, uint64_t(node.count) * simd::popcount(mask));
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    hitPrim(prim_indices[node.offset + i], mask);
+                }
+            } else {
+                uint32_t near_child = index + 1;
+                uint32_t far_child = node.offset;
+                if (negative[node.axis]) std::swap(near_child, far_child);
+                stack[sp++] = far_child;
+                stack[sp++] = near_child;
+            }
+        }
+    }
+
+    // 光线包遮挡遍历：hitPrim(prim_index, lane_mask) 返回被该图元挡住的射线掩码，
+    // 被挡住的射线不再参与后续遍历，全部挡住就提前结束；返回被遮挡的射线掩码
+    template <typename PrimFn>
+    uint32_t occludedPacket(const RayPacket& packet, PrimFn&& hitPrim) const {
+        uint32_t remaining = packet.active;
+        if (nodes.empty() || !remaining) return 0;
+
+        uint32_t stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = 0;
+
+        while (sp > 0 && remaining) {
+            const BVHNode& node = nodes[stack[--sp]];
+            uint32_t mask = packet.intersectBox(node.bounds) & remaining;
+            if (!mask) continue;
+
+            PT_STAT_ADD(kStatNodeVisits, simd::popcount(mask));
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.count && mask; ++i) {
+                    PT_STAT_ADD(kStatPrimTests, simd::popcount(mask));
+                    uint32_t blocked = hitPrim(prim_indices[node.offset + i], mask);
+                    mask &= ~blocked;
+                    remaining &= ~blocked;
+                }
+            } else {
+                stack[sp++] = node.offset;
+                stack[sp++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+            }
+        }
+        return packet.active & ~remaining;
+    }
+
+    bool empty() const { return nodes.empty(); }
+
+    AABB bounds() const {
+        return nodes.empty() ? AABB() : nodes[0].bounds;
+    }
+
+    size_t nodeCount() const { return nodes.size(); }
+
+    // 宽 BVH 从这里折叠，网格缓存也从这里取数据
+    const Buffer<BVHNode>& getNodes() const { return nodes; }
+    const Buffer<uint32_t>& primIndices() const { return prim_indices; }
+
+private:
+    struct BuildPrim {
+        AABB bounds;
+        Vector3f centroid;
+        uint32_t index;
+        uint32_t morton;  // 只有 LBVH 用
+    };
+
+    struct Bin {
+        AABB bounds;
+        uint32_t count = 0;
+    };
+
+    struct BuildContext {
+        std::vector<BuildPrim> prims;
+        BVHQuality quality;
+        ThreadPool* pool;
+    };
+
+    // 超过这个深度改用中位数划分，保证遍历栈不会溢出
+    static constexpr int kMaxSAHDepth = 32;
+    // 图元数不少于这么多的范围才拆成块并行统计，每块这么大
+    static constexpr uint32_t kParallelChunk = 16 * 1024;
+    // 图元数不少于这么多的节点，右子树交给线程池
+    static constexpr uint32_t kParallelSubtree = 4 * 1024;
+
+    Buffer<BVHNode> nodes;
+    Buffer<uint32_t> prim_indices;
+
+    // 把 [begin, end) 切成若干块执行 fn(begin, end, chunk)，块数不超过 chunkCount 的返回值；
+    // 范围太小或没有线程池时整段一次执行
+    static uint32_t chunkCount(const BuildContext& ctx, uint32_t begin, uint32_t end) {
+        const uint32_t count = end - begin;
+        if (!ctx.pool || count < 2 * kParallelChunk) return 1;
+        return (count + kParallelChunk - 1) / kParallelChunk;
+    }
+
+    template <typename F>
+    static void forChunks(const BuildContext& ctx, uint32_t begin, uint32_t end, F&& fn) {
+        const uint32_t chunks = chunkCount(ctx, begin, end);
+        if (chunks == 1) {
+            fn(begin, end, 0);
+            return;
+        }
+        ctx.pool->parallelFor(static_cast<int>(chunks), 1, [&](int c, int) {
+            const uint32_t b = begin + static_cast<uint32_t>(c) * kParallelChunk;
+            fn(b, std::min(end, b + kParallelChunk), c);
+        });
+    }
+
+    static uint32_t makeLeaf(std::vector<BVHNode>& nodes, uint32_t node_index, uint32_t begin, uint32_t end) {
+        nodes[node_index].offset = begin;
+        nodes[node_index].count = static_cast<uint16_t>(end - begin);
+        nodes[node_index].axis = 0;
+        return node_index;
+    }
+
+    // 节点写进 nodes（构建用的局部数组，建完再交给成员 nodes），返回节点在 nodes 中的下标
+    uint32_t buildNode(BuildContext& ctx, std::vector<BVHNode>& nodes,
+                       uint32_t begin, uint32_t end, int depth) {
+        uint32_t node_index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        AABB bounds, centroid_bounds;
+        rangeBounds(ctx, begin, end, bounds, centroid_bounds);
+        nodes[node_index].bounds = bounds;
+
+        uint32_t count = end - begin;
+        if (count <= 1) {
+            return makeLeaf(nodes, node_index, begin, end);
+        }
+
+        int axis = -1;
+        uint32_t mid = begin;
+        if (ctx.quality == BVHQuality::LBVH) {
+            if (count > static_cast<uint32_t>(kMaxLeafSize)) {
+                splitMorton(ctx, begin, end, axis, mid);
+            }
+        } else if (depth < kMaxSAHDepth) {
+            if (ctx.quality == BVHQuality::Sweep && count <= kSweepMaxPrims) {
+                splitSweep(ctx, begin, end, bounds, axis, mid);
+            } else {
+                splitBinned(ctx, begin, end, bounds, centroid_bounds, axis, mid);
+            }
+            // SAH 认为做叶子更划算
+            if (axis < 0 && mid == end) {
+                return makeLeaf(nodes, node_index, begin, end);
+            }
+        }
+
+        if (axis < 0) {
+            // 质心重合（或深度过大）：小的直接做叶子，否则按最长轴中位数切开
+            if (count <= kMaxLeafSize) {
+                return makeLeaf(nodes, node_index, begin, end);
+            }
+            axis = centroid_bounds.maxExtentAxis();
+            mid = begin + count / 2;
+            std::nth_element(ctx.prims.begin() + begin, ctx.prims.begin() + mid, ctx.prims.begin() + end,
+                [axis](const BuildPrim& a, const BuildPrim& b) {
+                    return axisOf(a.centroid, axis) < axisOf(b.centroid, axis);
+                });
+        }
+
+        nodes[node_index].axis = static_cast<uint16_t>(axis);
+        nodes[node_index].count = 0;
+        uint32_t right;
+        if (ctx.pool && count >= kParallelSubtree) {
+            // 右子树在线程池里建到单独的数组，左子树就地建完后再把右子树接到后面
+            std::vector<BVHNode> right_nodes;
+            TaskGroup group;
+            ctx.pool->submit(group, [&](int) {
+                right_nodes.reserve(2 * (end - mid));
+                buildNode(ctx, right_nodes, mid, end, depth + 1);
+            });
+            buildNode(ctx, nodes, begin, mid, depth + 1);
+            ctx.pool->wait(group);
+
+            right = static_cast<uint32_t>(nodes.size());
+            for (BVHNode node : right_nodes) {
+                if (!node.isLeaf()) node.offset += right;
+                nodes.push_back(node);
+            }
+        } else {
+            buildNode(ctx, nodes, begin, mid, depth + 1);
+            right = buildNode(ctx, nodes, mid, end, depth + 1);
+        }
+        nodes[node_index].offset = right;
+        return node_index;
+    }
+
+    static void rangeBounds(const BuildContext& ctx, uint32_t begin, uint32_t end,
+                            AABB& bounds, AABB& centroid_bounds) {
+        const uint32_t chunks = chunkCount(ctx, begin, end);
+        std::vector<AABB> partial(2 * chunks);
+        forChunks(ctx, begin, end, [&](uint32_t b, uint32_t e, int c) {
+            for (uint32_t i = b; i < e; ++i) {
+                partial[2 * c].expand(ctx.prims[i].bounds);
+                partial[2 * c + 1].expand(ctx.prims[i].centroid);
+            }
+        });
+        for (uint32_t c = 0; c < chunks; ++c) {
+            bounds.expand(partial[2 * c]);
+            centroid_bounds.expand(partial[2 * c + 1]);
+        }
+    }
+
+    // 分桶 SAH：axis 为划分轴、mid 为划分位置；SAH 判定做叶子时 axis < 0 且 mid = end，
+    // 找不到划分（质心重合）时 axis < 0 且 mid 不变
+    static void splitBinned(BuildContext& ctx, uint32_t begin, uint32_t end, const AABB& bounds,
+                            const AABB& centroid_bounds, int& axis, uint32_t& mid) {
+        const uint32_t count = end - begin;
+        float c_min[3], scale[3];
+        for (int a = 0; a < 3; ++a) {
+            c_min[a] = axisOf(centroid_bounds.min_p, a);
+            float c_max = axisOf(centroid_bounds.max_p, a);
+            scale[a] = (c_max > c_min[a]) ? kBins / (c_max - c_min[a]) : 0.0f;
+        }
+
+        // 三个轴一起分桶；大节点按块并行，最后按块的顺序合并
+        const uint32_t chunks = chunkCount(ctx, begin, end);
+        std::vector<Bin> partial(static_cast<size_t>(chunks) * 3 * kBins);
+        forChunks(ctx, begin, end, [&](uint32_t b, uint32_t e, int c) {
+            Bin* bins = &partial[static_cast<size_t>(c) * 3 * kBins];
+            for (uint32_t i = b; i < e; ++i) {
+                const BuildPrim& p = ctx.prims[i];
+                for (int a = 0; a < 3; ++a) {
+                    if (scale[a] == 0.0f) continue;
+                    Bin& bin = bins[a * kBins + binIndex(axisOf(p.centroid, a), c_min[a], scale[a])];
+                    bin.count++;
+                    bin.bounds.expand(p.bounds);
+                }
+            }
+        });
+
+        int best_axis = -1;
+        int best_split = -1;
+        float best_cost = std::numeric_limits<float>::max();
+        for (int a = 0; a < 3; ++a) {
+            if (scale[a] == 0.0f) continue;
+            Bin bins[kBins];
+            for (uint32_t c = 0; c < chunks; ++c) {
+                const Bin* src = &partial[(static_cast<size_t>(c) * 3 + a) * kBins];
+                for (int b = 0; b < kBins; ++b) {
+                    bins[b].count += src[b].count;
+                    bins[b].bounds.expand(src[b].bounds);
+                }
+            }
+
+            // 从右往左扫一遍，记录右侧的面积 * 个数
+            float right_cost[kBins];
+            AABB right_box;
+            uint32_t right_count = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                right_box.expand(bins[b].bounds);
+                right_count += bins[b].count;
+                right_cost[b] = right_count * right_box.surfaceArea();
+            }
+
+            AABB left_box;
+            uint32_t left_count = 0;
+            for (int b = 0; b < kBins - 1; ++b) {
+                left_box.expand(bins[b].bounds);
+                left_count += bins[b].count;
+                if (left_count == 0 || left_count == count) continue;
+                float cost = left_count * left_box.surfaceArea() + right_cost[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = b;
+                }
+            }
+        }
+        if (best_axis < 0) return;
+
+        // SAH：遍历代价记为 1，每个图元求交代价记为 1
+        float leaf_cost = static_cast<float>(count);
+        float split_cost = 1.0f + best_cost / bounds.surfaceArea();
+        if (count <= kMaxLeafSize && leaf_cost <= split_cost) {
+            mid = end;
+            return;
+        }
+
+        const float a_min = c_min[best_axis];
+        const float a_scale = scale[best_axis];
+        auto it = std::partition(ctx.prims.begin() + begin, ctx.prims.begin() + end,
+            [&](const BuildPrim& p) {
+                return binIndex(axisOf(p.centroid, best_axis), a_min, a_scale) <= best_split;
+            });
+        mid = static_cast<uint32_t>(it - ctx.prims.begin());
+        axis = best_axis;
+    }
+
+    // 完整 SAH：每个轴按质心排序（相同时按图元下标，结果与排序实现无关），在每个位置上求代价
+    static void splitSweep(BuildContext& ctx, uint32_t begin, uint32_t end, const AABB& bounds,
+                           int& axis, uint32_t& mid) {
+        const uint32_t count = end - begin;
+        auto first = ctx.prims.begin() + begin;
+        auto last = ctx.prims.begin() + end;
+        auto byAxis = [](int a) {
+            return [a](const BuildPrim& p, const BuildPrim& q) {
+                float cp = axisOf(p.centroid, a), cq = axisOf(q.centroid, a);
+                return cp < cq || (cp == cq && p.index < q.index);
+            };
+        };
+
+        std::vector<float> right_cost(count);
+        int best_axis = -1;
+        uint32_t best_split = 0;
+        float best_cost = std::numeric_limits<float>::max();
+        for (int a = 0; a < 3; ++a) {
+            std::sort(first, last, byAxis(a));
+            AABB right_box;
+            for (uint32_t i = count; i-- > 1;) {
+                right_box.expand(ctx.prims[begin + i].bounds);
+                right_cost[i] = (count - i) * right_box.surfaceArea();
+            }
+            AABB left_box;
+            for (uint32_t i = 1; i < count; ++i) {
+                left_box.expand(ctx.prims[begin + i - 1].bounds);
+                float cost = i * left_box.surfaceArea() + right_cost[i];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = i;
+                }
+            }
+        }
+
+        float leaf_cost = static_cast<float>(count);
+        float split_cost = 1.0f + best_cost / bounds.surfaceArea();
+        if (count <= kMaxLeafSize && leaf_cost <= split_cost) {
+            mid = end;
+            return;
+        }
+        if (best_axis != 2) std::sort(first, last, byAxis(best_axis));
+        mid = begin + best_split;
+        axis = best_axis;
+    }
+
+    // 30 位 Morton 码（每轴 10 位，x 在最高位），按码排序；相同的码按图元下标排
+    static uint32_t expandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    static void sortByMorton(BuildContext& ctx) {
+        const uint32_t n = static_cast<uint32_t>(ctx.prims.size());
+        AABB bounds, centroid_bounds;
+        rangeBounds(ctx, 0, n, bounds, centroid_bounds);
+        float c_min[3], scale[3];
+        for (int a = 0; a < 3; ++a) {
+            c_min[a] = axisOf(centroid_bounds.min_p, a);
+            float extent = axisOf(centroid_bounds.max_p, a) - c_min[a];
+            scale[a] = (extent > 0.0f) ? 1023.0f / extent : 0.0f;
+        }
+        forChunks(ctx, 0, n, [&](uint32_t begin, uint32_t end, int) {
+            for (uint32_t i = begin; i < end; ++i) {
+                uint32_t q[3];
+                for (int a = 0; a < 3; ++a) {
+                    float x = (axisOf(ctx.prims[i].centroid, a) - c_min[a]) * scale[a];
+                    q[a] = static_cast<uint32_t>(std::min(std::max(x, 0.0f), 1023.0f));
+                }
+                ctx.prims[i].morton = (expandBits(q[0]) << 2) | (expandBits(q[1]) << 1) | expandBits(q[2]);
+            }
+        });
+
+        auto less = [](const BuildPrim& a, const BuildPrim& b) {
+            return a.morton < b.morton || (a.morton == b.morton && a.index < b.index);
+        };
+        const uint32_t chunks = chunkCount(ctx, 0, n);
+        if (chunks == 1) {
+            std::sort(ctx.prims.begin(), ctx.prims.end(), less);
+            return;
+        }
+        // 各块并行排序，再两两归并
+        forChunks(ctx, 0, n, [&](uint32_t begin, uint32_t end, int) {
+            std::sort(ctx.prims.begin() + begin, ctx.prims.begin() + end, less);
+        });
+        for (uint32_t width = kParallelChunk; width < n; width *= 2) {
+            const int pairs = static_cast<int>((n + 2 * width - 1) / (2 * width));
+            ctx.pool->parallelFor(pairs, 1, [&](int k, int) {
+                const size_t begin = static_cast<size_t>(k) * 2 * width;
+                const size_t middle = std::min<size_t>(n, begin + width);
+                const size_t end = std::min<size_t>(n, begin + 2 * width);
+                std::inplace_merge(ctx.prims.begin() + begin, ctx.prims.begin() + middle,
+                                   ctx.prims.begin() + end, less);
+            });
+        }
+    }
+
+    // 已按 Morton 码排好序的范围：在首尾两个码最高的不同位上切开，该位为 0 的在左边
+    // 码全部相同时 axis 保持 < 0，由调用方按中位数切开
+    static void splitMorton(const BuildContext& ctx, uint32_t begin, uint32_t end, int& axis, uint32_t& mid) {
+        const uint32_t first_code = ctx.prims[begin].morton;
+        const uint32_t last_code = ctx.prims[end - 1].morton;
+        if (first_code == last_code) return;
+        int bit = 31;
+        while (!(((first_code ^ last_code) >> bit) & 1u)) --bit;
+        auto it = std::partition_point(ctx.prims.begin() + begin, ctx.prims.begin() + end,
+            [bit](const BuildPrim& p) { return !((p.morton >> bit) & 1u); });
+        mid = static_cast<uint32_t>(it - ctx.prims.begin());
+        // 码的第 3k+2 / 3k+1 / 3k 位分别来自 x / y / z
+        axis = 2 - bit % 3;
+    }
+
+    static int binIndex(float c, float c_min, float scale) {
+        int b = static_cast<int>((c - c_min) * scale);
+        return std::min(std::max(b, 0), kBins - 1);
+    }
+};
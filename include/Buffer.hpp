@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 只读数组：数据要么由自己的 std::vector 持有，要么直接指向外部内存（例如 mmap 进来的网格缓存）
+// 指向外部内存时不拷贝，外部内存的生命周期由使用者保证
+template <typename T>
+class Buffer {
+public:
+    Buffer() = default;
+
+    Buffer(std::vector<T>&& v) : owned(std::move(v)), ptr(owned.data()), count(owned.size()) {}
+
+    static Buffer view(const T* data, size_t n) {
+        Buffer b;
+        b.ptr = data;
+        b.count = n;
+        return b;
+    }
+
+    Buffer(const Buffer& o) : owned(o.owned), ptr(o.ownsData() ? owned.data() : o.ptr), count(o.count) {}
+
+    // vector 移动后数据地址不变，ptr 仍然有效
+    Buffer(Buffer&& o) noexcept : owned(std::move(o.owned)), ptr(o.ptr), count(o.count) {
+        o.ptr = nullptr;
+        o.count = 0;
+    }
+
+    Buffer& operator=(Buffer o) noexcept {
+        owned.swap(o.owned);
+        std::swap(ptr, o.ptr);
+        std::swap(count, o.count);
+        return *this;
+    }
+
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* data() const { return ptr; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    // false 表示数据在外部内存里
+    bool ownsData() const { return !owned.empty() && ptr == owned.data(); }
+
+private:
+    std::vector<T> owned;
+    const T* ptr = nullptr;
+    size_t count = 0;
+};
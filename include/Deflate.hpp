@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "ThreadPool.hpp"
+
+// 给 PNG 用的最小 zlib 压缩：LZ77（哈希链找匹配）加固定 Huffman 编码
+// 输入按固定大小切段，各段独立压缩（匹配不跨段），段尾用空的 stored 块对齐到字节后直接拼接，
+// 这样各段可以并行压，而且结果与线程数无关。固定码表比动态码表稍大一些，对渲染结果影响不大
+class Deflate {
+public:
+    static uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0) {
+        static const CrcTable table;
+        crc = ~crc;
+        for (size_t i = 0; i < n; ++i) crc = table.t[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    static uint32_t adler32(const uint8_t* data, size_t n) {
+        uint32_t a = 1, b = 0;
+        while (n > 0) {
+            // 5552 是 b 不会溢出 32 位的最大块长
+            size_t len = std::min<size_t>(n, 5552);
+            n -= len;
+            for (size_t i = 0; i < len; ++i) {
+                a += data[i];
+                b += a;
+            }
+            data += len;
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    // zlib 格式（2 字节头 + deflate 数据 + Adler-32），pool 为空时单线程
+    static std::vector<uint8_t> zlibCompress(const uint8_t* data, size_t n, ThreadPool* pool) {
+        const size_t segments = std::max<size_t>(1, (n + kSegmentBytes - 1) / kSegmentBytes);
+        std::vector<std::vector<uint8_t>> parts(segments);
+        auto compressSegment = [&](size_t s) {
+            const size_t begin = s * kSegmentBytes;
+            const size_t end = std::min(n, begin + kSegmentBytes);
+            parts[s] = compressBlock(data + begin, end - begin, s + 1 == segments);
+        };
+        if (pool && pool->size() > 1 && segments > 1) {
+            pool->parallelFor(static_cast<int>(segments), 1, [&](int s, int) { compressSegment(s); });
+        } else {
+            for (size_t s = 0; s < segments; ++s) compressSegment(s);
+        }
+
+        std::vector<uint8_t> out;
+        size_t total = 6;
+        for (const auto& p : parts) total += p.size();
+        out.reserve(total);
+        // CMF = 0x78（32K 窗口），FLG 使 CMF*256+FLG 是 31 的倍数
+        out.push_back(0x78);
+        out.push_back(0x01);
+        for (const auto& p : parts) out.insert(out.end(), p.begin(), p.end());
+        const uint32_t adler = adler32(data, n);
+        for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(adler >> shift));
+        return out;
+    }
+
+private:
+    static constexpr size_t kSegmentBytes = 256 * 1024;
+    static constexpr int kHashBits = 15;
+    static constexpr int kMaxChain = 32;
+    static constexpr int kMinMatch = 3;
+    static constexpr int kMaxMatch = 258;
+    static constexpr int kWindow = 32768;
+
+    struct CrcTable {
+        uint32_t t[256];
+        CrcTable() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+                t[i] = c;
+            }
+        }
+    };
+
+    // deflate 的位序：数值从低位开始写，Huffman 码从高位开始写
+    struct BitWriter {
+        std::vector<uint8_t> out;
+        uint64_t bits = 0;
+        int count = 0;
+
+        void put(uint32_t value, int n) {
+            bits |= static_cast<uint64_t>(value) << count;
+            count += n;
+            while (count >= 8) {
+                out.push_back(static_cast<uint8_t>(bits));
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+
+        void putCode(uint32_t code, int n) {
+            uint32_t reversed = 0;
+            for (int i = 0; i < n; ++i) reversed |= ((code >> i) & 1u) << (n - 1 - i);
+            put(reversed, n);
+        }
+
+        void alignByte() {
+            if (count > 0) put(0, 8 - count);
+        }
+    };
+
+    // 固定 Huffman 码表里的字面量 / 长度符号
+    static void putLiteral(BitWriter& w, int sym) {
+        if (sym < 144)      w.putCode(0x30 + sym, 8);
+        else if (sym < 256) w.putCode(0x190 + (sym - 144), 9);
+        else if (sym < 280) w.putCode(sym - 256, 7);
+        else                w.putCode(0xc0 + (sym - 280), 8);
+    }
+
+    static void putMatch(BitWriter& w, int length, int distance) {
+        static const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                               257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                               8193, 12289, 16385, 24577};
+        static const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                               7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        int lc = 28;
+        while (kLengthBase[lc] > length) --lc;
+        putLiteral(w, 257 + lc);
+        w.put(static_cast<uint32_t>(length - kLengthBase[lc]), kLengthExtra[lc]);
+        int dc = 29;
+        while (kDistBase[dc] > distance) --dc;
+        w.putCode(static_cast<uint32_t>(dc), 5);
+        w.put(static_cast<uint32_t>(distance - kDistBase[dc]), kDistExtra[dc]);
+    }
+
+    static uint32_t hash3(const uint8_t* p) {
+        uint32_t v = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                     (static_cast<uint32_t>(p[2]) << 16);
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    // 一段数据压成一个固定 Huffman 块；不是最后一段时再补一个空 stored 块把位流对齐到字节
+    static std::vector<uint8_t> compressBlock(const uint8_t* data, size_t n, bool final_block) {
+        BitWriter w;
+        w.out.reserve(n / 2 + 64);
+        w.put(final_block ? 1u : 0u, 1);
+        w.put(1, 2);  // BTYPE = 01，固定码表
+
+        std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+        std::vector<int32_t> prev(n, -1);
+        auto insert = [&](size_t pos) {
+            uint32_t h = hash3(data + pos);
+            prev[pos] = head[h];
+            head[h] = static_cast<int32_t>(pos);
+        };
+
+        size_t i = 0;
+        while (i < n) {
+            int best_len = 0, best_dist = 0;
+            if (i + kMinMatch <= n) {
+                const int max_len = static_cast<int>(std::min<size_t>(kMaxMatch, n - i));
+                int32_t cand = head[hash3(data + i)];
+                for (int chain = 0; cand >= 0 && chain < kMaxChain; ++chain, cand = prev[cand]) {
+                    const int dist = static_cast<int>(i) - cand;
+                    if (dist > kWindow) break;
+                    const uint8_t* a = data + cand;
+                    const uint8_t* b = data + i;
+                    if (a[best_len] != b[best_len]) continue;
+                    int len = 0;
+                    while (len < max_len && a[len] == b[len]) ++len;
+                    if (len > best_len) {
+                        best_len = len;
+                        best_dist = dist;
+                        if (len == max_len) break;
+                    }
+                }
+            }
+            if (best_len >= kMinMatch) {
+                putMatch(w, best_len, best_dist);
+                const size_t stop = std::min(i + best_len, n - kMinMatch + 1);
+                for (size_t k = i; k < stop; ++k) insert(k);
+                i += best_len;
+            } else {
+                putLiteral(w, data[i]);
+                if (i + kMinMatch <= n) insert(i);
+                ++i;
+            }
+        }
+        putLiteral(w, 256);
+
+        if (!final_block) {
+            w.put(0, 1);
+            w.put(0, 2);  // 空 stored 块：对齐后是 LEN = 0、NLEN = 0xffff
+            w.alignByte();
+            const uint8_t sync[4] = {0x00, 0x00, 0xff, 0xff};
+            w.out.insert(w.out.end(), sync, sync + 4);
+        } else {
+            w.alignByte();
+        }
+        return std::move(w.out);
+    }
+};
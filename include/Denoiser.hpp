@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "global.hpp"
+#include "Renderer.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+struct DenoiseSettings {
+    // à-trous 迭代次数，第 k 次的采样间隔是 2^k 像素，5 次覆盖约 130 像素宽的范围
+    int iterations = 5;
+    // 亮度差按 sigma_luminance 倍标准差归一化，越大越平滑
+    float sigma_luminance = 4.0f;
+    // 深度差按 sigma_depth 倍的（深度梯度 x 距离）归一化
+    float sigma_depth = 1.0f;
+};
+
+// 边缘保持的 à-trous 小波滤波（SVGF 的空间部分），用 Renderer 记录的 AOV 引导：
+// 颜色先除以反照率得到照度，只对照度滤波，最后再乘回去，贴图细节不会被抹掉；
+// 每次迭代是间隔 2^k 的 5x5 B3 样条核，权重再乘上法线、深度、亮度三个边缘项。
+// 亮度项按方差归一化（方差来自样本亮度的二阶矩），噪声大的地方滤得狠，收敛的地方几乎不动；
+// 方差随权重一起传播，所以越往后的迭代越保守。
+// 各缓冲按 SoA 平面存放，四周留 pad 像素的空边：空边和没打中的像素法线为 0，法线权重自然为 0，
+// 内层循环不用判断边界，8 个像素一组做 SIMD
+class Denoiser {
+public:
+    explicit Denoiser(const DenoiseSettings& settings = DenoiseSettings()) : settings(settings) {}
+
+    // color、aov、counts 与 Renderer 的输出同样布局（见 Renderer::pixelAovs / sampleCounts）
+    // 结果写到 out，out 可以就是 color
+    void denoise(ThreadPool& pool, int width, int height, const std::vector<Vector3f>& color,
+                 const std::vector<PixelAov>& aov, const std::vector<uint32_t>& counts,
+                 std::vector<Vector3f>& out) const {
+        const int iterations = std::max(0, settings.iterations);
+        if (iterations == 0 || width <= 0 || height <= 0) {
+            out = color;
+            return;
+        }
+
+        Planes pl;
+        pl.pad = 2 << (iterations - 1);  // 最后一次迭代的核半径
+        pl.stride = pl.pad + (width + kLanes - 1) / kLanes * kLanes + pl.pad;
+        pl.rows = height + 2 * pl.pad;
+        const size_t size = static_cast<size_t>(pl.stride) * pl.rows;
+        for (std::vector<float>* p : {&pl.nx, &pl.ny, &pl.nz, &pl.z, &pl.inv_z, &pl.inv_l}) p->assign(size, 0.0f);
+        for (int k = 0; k < 2; ++k) {
+            for (std::vector<float>* p : {&pl.r[k], &pl.g[k], &pl.b[k], &pl.var[k]}) p->assign(size, 0.0f);
+        }
+
+        std::vector<Vector3f> demod(static_cast<size_t>(width) * height);
+        prepare(pl, width, height, color, aov, counts, demod);
+
+        // 两套颜色 / 方差平面来回倒；每次迭代先在整幅图上预滤方差，再做 à-trous
+        int src = 0;
+        for (int it = 0; it < iterations; ++it) {
+            parallelRows(pool, height, [&](int y0, int y1) { filterVariance(pl, src, width, y0, y1); });
+            parallelRows(pool, height, [&](int y0, int y1) { atrous(pl, src, 1 << it, width, y0, y1); });
+            src ^= 1;
+        }
+
+        out.resize(demod.size());
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t i = pl.index(x, y);
+                const size_t p = static_cast<size_t>(y) * width + x;
+                out[p] = Vector3f(pl.r[src][i], pl.g[src][i], pl.b[src][i]) * demod[p];
+            }
+        }
+    }
+
+private:
+    static constexpr int kLanes = 8;
+    using vfloat = simd::vfloat<kLanes>;
+
+    // 反照率低于这个值的通道不做除法，避免把噪声放大
+    static constexpr float kMinAlbedo = 0.01f;
+    static constexpr float kEpsilon = 1e-6f;
+    // 深度梯度的下限（相对深度），正对相机的平面梯度接近 0，深度上的一点抖动就会把权重压没
+    static constexpr float kMinDepthGradient = 1e-3f;
+    // 法线权重 max(0, n.n')^128，用 7 次平方得到
+    static constexpr int kNormalSquarings = 7;
+
+    struct Planes {
+        int pad = 0, stride = 0, rows = 0;
+        std::vector<float> nx, ny, nz, z;
+        std::vector<float> inv_z;  // 1 / (sigma_depth * 深度梯度)
+        std::vector<float> inv_l;  // 1 / (sigma_luminance * 标准差)，每次迭代由预滤后的方差重算
+        std::vector<float> r[2], g[2], b[2], var[2];
+
+        size_t index(int x, int y) const {
+            return static_cast<size_t>(y + pad) * stride + (x + pad);
+        }
+    };
+
+    DenoiseSettings settings;
+
+    static float luminance(float r, float g, float b) {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    static vfloat luminance(const vfloat& r, const vfloat& g, const vfloat& b) {
+        return r * vfloat::broadcast(0.2126f) + g * vfloat::broadcast(0.7152f) + b * vfloat::broadcast(0.0722f);
+    }
+
+    // exp(-x) 的近似 (1 + x/8)^-8，x >= 0；边缘权重只要单调、快速衰减，不需要精确
+    static vfloat expNeg(const vfloat& x) {
+        vfloat t = vfloat::broadcast(1.0f) + x * vfloat::broadcast(0.125f);
+        t = t * t;
+        t = t * t;
+        t = t * t;
+        return vfloat::broadcast(1.0f) / t;
+    }
+
+    // 按行分段交给线程池，f(y0, y1) 处理 [y0, y1) 行
+    template <typename F>
+    static void parallelRows(ThreadPool& pool, int height, const F& f) {
+        const int band = std::max(1, height / (4 * std::max(1, pool.size())));
+        TaskGroup group;
+        for (int y0 = 0; y0 < height; y0 += band) {
+            const int y1 = std::min(height, y0 + band);
+            pool.submit(group, [&f, y0, y1](int) { f(y0, y1); });
+        }
+        pool.wait(group);
+    }
+
+    // 填平面：归一化法线、深度、深度梯度、除以反照率后的照度和它的方差；demod 记下用过的反照率
+    void prepare(Planes& pl, int width, int height, const std::vector<Vector3f>& color,
+                 const std::vector<PixelAov>& aov, const std::vector<uint32_t>& counts,
+                 std::vector<Vector3f>& demod) const {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t p = static_cast<size_t>(y) * width + x;
+                const size_t i = pl.index(x, y);
+                const PixelAov& a = aov[p];
+                const float len = a.normal.length();
+                if (len > 0.0f) {
+                    pl.nx[i] = a.normal.x / len;
+                    pl.ny[i] = a.normal.y / len;
+                    pl.nz[i] = a.normal.z / len;
+                }
+                pl.z[i] = a.depth;
+
+                Vector3f d(a.albedo.x > kMinAlbedo ? a.albedo.x : 1.0f,
+                           a.albedo.y > kMinAlbedo ? a.albedo.y : 1.0f,
+                           a.albedo.z > kMinAlbedo ? a.albedo.z : 1.0f);
+                demod[p] = d;
+                pl.r[0][i] = color[p].x / d.x;
+                pl.g[0][i] = color[p].y / d.y;
+                pl.b[0][i] = color[p].z / d.z;
+
+                // 均值的方差 = 样本方差 / n = (E[y^2] - mean^2) / (n - 1)；只有一个样本时用 E[y^2] 粗略代替
+                const float n = static_cast<float>(counts[p]);
+                const float mean = luminance(color[p].x, color[p].y, color[p].z);
+                float var = n > 1.0f ? std::max(0.0f, a.lum2 - mean * mean) / (n - 1.0f) : a.lum2;
+                const float dl = luminance(d.x, d.y, d.z);
+                pl.var[0][i] = var / (dl * dl);
+            }
+        }
+
+        // 深度梯度：每个方向取前后差分里小的那个，深度不连续处不会把梯度估得过大
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const size_t i = pl.index(x, y);
+                auto diff = [&](int xx, int yy) {
+                    if (xx < 0 || yy < 0 || xx >= width || yy >= height) return std::numeric_limits<float>::max();
+                    return std::fabs(pl.z[pl.index(xx, yy)] - pl.z[i]);
+                };
+                float gx = std::min(diff(x - 1, y), diff(x + 1, y));
+                float gy = std::min(diff(x, y - 1), diff(x, y + 1));
+                if (gx == std::numeric_limits<float>::max()) gx = 0.0f;
+                if (gy == std::numeric_limits<float>::max()) gy = 0.0f;
+                const float grad = std::max(std::max(gx, gy), kMinDepthGradient * pl.z[i]);
+                pl.inv_z[i] = 1.0f / (settings.sigma_depth * grad + kEpsilon);
+            }
+        }
+    }
+
+    // 3x3 高斯预滤方差（少量样本时单个像素的方差很不可靠），换算成亮度权重的系数
+    void filterVariance(Planes& pl, int src, int width, int y0, int y1) const {
+        static const float kGauss[3] = {0.25f, 0.5f, 0.25f};
+        const std::vector<float>& var = pl.var[src];
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float sum = 0.0f;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        sum += kGauss[dx + 1] * kGauss[dy + 1] * var[pl.index(x + dx, y + dy)];
+                    }
+                }
+                pl.inv_l[pl.index(x, y)] = 1.0f / (settings.sigma_luminance * std::sqrt(std::max(sum, 0.0f)) + kEpsilon);
+            }
+        }
+    }
+
+    // 一次 à-trous 迭代：src 平面 -> 另一套平面，间隔 step
+    // 每行按 8 个像素一组，最后一组可能伸进右侧空边，写进去的值不会被用到（空边法线为 0）
+    void atrous(Planes& pl, int src, int step, int width, int y0, int y1) const {
+        static const float kB3[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+        const int dst = src ^ 1;
+        const float* r = pl.r[src].data();
+        const float* g = pl.g[src].data();
+        const float* b = pl.b[src].data();
+        const float* var = pl.var[src].data();
+        const vfloat zero = vfloat::broadcast(0.0f);
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = 0; x < width; x += kLanes) {
+                const size_t c = pl.index(x, y);
+                const vfloat nx = vfloat::loadu(&pl.nx[c]);
+                const vfloat ny = vfloat::loadu(&pl.ny[c]);
+                const vfloat nz = vfloat::loadu(&pl.nz[c]);
+                const vfloat z = vfloat::loadu(&pl.z[c]);
+                const vfloat inv_z = vfloat::loadu(&pl.inv_z[c]);
+                const vfloat inv_l = vfloat::loadu(&pl.inv_l[c]);
+                const vfloat rc = vfloat::loadu(r + c);
+                const vfloat gc = vfloat::loadu(g + c);
+                const vfloat bc = vfloat::loadu(b + c);
+                const vfloat lc = luminance(rc, gc, bc);
+
+                // 中心像素不看边缘项，保证权重和不为 0（没打中的像素因此保持原样）
+                const vfloat wc = vfloat::broadcast(kB3[2] * kB3[2]);
+                vfloat sum_w = wc;
+                vfloat sum_r = rc * wc, sum_g = gc * wc, sum_b = bc * wc;
+                vfloat sum_var = vfloat::loadu(var + c) * wc * wc;
+
+                for (int ky = 0; ky < 5; ++ky) {
+                    for (int kx = 0; kx < 5; ++kx) {
+                        if (kx == 2 && ky == 2) continue;
+                        const int dx = kx - 2, dy = ky - 2;
+                        const size_t q = c + static_cast<ptrdiff_t>(dy * step) * pl.stride + dx * step;
+
+                        vfloat dot = nx * vfloat::loadu(&pl.nx[q]) + ny * vfloat::loadu(&pl.ny[q]) +
+                                     nz * vfloat::loadu(&pl.nz[q]);
+                        vfloat wn = simd::max(dot, zero);
+                        for (int s = 0; s < kNormalSquarings; ++s) wn = wn * wn;
+
+                        const vfloat rq = vfloat::loadu(r + q);
+                        const vfloat gq = vfloat::loadu(g + q);
+                        const vfloat bq = vfloat::loadu(b + q);
+                        const float inv_dist = 1.0f / (step * std::sqrt(static_cast<float>(dx * dx + dy * dy)));
+                        const vfloat e = simd::abs(luminance(rq, gq, bq) - lc) * inv_l +
+                                         simd::abs(vfloat::loadu(&pl.z[q]) - z) * inv_z * vfloat::broadcast(inv_dist);
+                        const vfloat w = vfloat::broadcast(kB3[kx] * kB3[ky]) * wn * expNeg(e);
+
+                        sum_w = sum_w + w;
+                        sum_r = sum_r + rq * w;
+                        sum_g = sum_g + gq * w;
+                        sum_b = sum_b + bq * w;
+                        sum_var = sum_var + vfloat::loadu(var + q) * w * w;
+                    }
+                }
+
+                const vfloat inv_w = vfloat::broadcast(1.0f) / sum_w;
+                (sum_r * inv_w).storeu(&pl.r[dst][c]);
+                (sum_g * inv_w).storeu(&pl.g[dst][c]);
+                (sum_b * inv_w).storeu(&pl.b[dst][c]);
+                (sum_var * inv_w * inv_w).storeu(&pl.var[dst][c]);
+            }
+        }
+    }
+};
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include "global.hpp"
 
 // 前向声明，避免头文件循环依赖
 class Material;
 
+// 遍历过程中只记录的最少信息：t、图元下标和重心坐标
+// 其余属性等找到最终的最近交点后再一次性计算（见 MeshTriangle::finalizeHit）
+struct PrimitiveHit {
+    float t = std::numeric_limits<float>::max();
+    uint32_t prim = 0;
+    float u = 0.0f;
+    float v = 0.0f;
+};
+
 struct HitRecord {
     Vector3f p;           // 交点位置
     Vector3f N;           // 交点处法线（朝外方向）
@@ -14,9 +24,15 @@ struct HitRecord {
     float t;              // 光线参数 t（Ray(origin + t * dir)）
     bool front_face;      // 是否是从物体外部射入（true: 正面）
 
+    // 贴图 LOD 用：sqrt(三角形 uv 面积 / 世界空间面积)，没有 UV 时为 0；
+    // uv_footprint 由积分器按射线锥算出（见 Scene::setTextureFootprint）
+    float uv_density;
+    float uv_footprint;
+
     HitRecord()
         : p(), N(), uv(), material(nullptr),
-          t(std::numeric_limits<float>::max()), front_face(true) {}
+          t(std::numeric_limits<float>::max()), front_face(true),
+          uv_density(0.0f), uv_footprint(0.0f) {}
 
     // 设定法线方向，使其总是与光线方向相反（这在路径追踪中很常用）
     inline void set_face_normal(const Ray& r, const Vector3f& outward_normal) {
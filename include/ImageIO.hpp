@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "global.hpp"
+#include "Deflate.hpp"
+#include "ThreadPool.hpp"
+
+// 图像输出：按扩展名选格式
+//   .ppm  二进制 P6，8 位，sqrt gamma
+//   .png  8 位 RGB，sqrt gamma，自带的 deflate 压缩
+//   .pfm  32 位浮点线性辐射度，不做色调映射，给对比、降噪工具用
+// framebuffer 的第 0 行是图像最下面一行（与相机的 v 方向一致）
+enum class ImageFormat {
+    PPM,
+    PNG,
+    PFM
+};
+
+inline const char* imageFormatName(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::PPM: return "ppm";
+        case ImageFormat::PNG: return "png";
+        case ImageFormat::PFM: return "pfm";
+    }
+    return "unknown";
+}
+
+// 扩展名不认识时返回 false
+inline bool imageFormatFromPath(const std::string& path, ImageFormat& format) {
+    auto dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    for (char& c : ext) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    if (ext == "ppm") format = ImageFormat::PPM;
+    else if (ext == "png") format = ImageFormat::PNG;
+    else if (ext == "pfm") format = ImageFormat::PFM;
+    else return false;
+    return true;
+}
+
+// 行的并行粒度；每行的工作量相同，不需要更细
+static constexpr int kImageRowGrain = 16;
+
+template <typename F>
+inline void forEachImageRow(int height, ThreadPool* pool, F&& fn) {
+    if (pool && pool->size() > 1) {
+        pool->parallelFor(height, kImageRowGrain, [&](int row, int) { fn(row); });
+    } else {
+        for (int row = 0; row < height; ++row) fn(row);
+    }
+}
+
+// 线性辐射度 -> 8 位 RGB，从最上面一行开始；截断到 [0,1] 后取 sqrt 作为 gamma
+inline void tonemapRGB8(const std::vector<Vector3f>& framebuffer, int width, int height,
+                        std::vector<uint8_t>& rgb, ThreadPool* pool) {
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    forEachImageRow(height, pool, [&](int row) {
+        const Vector3f* src = framebuffer.data() + static_cast<size_t>(height - 1 - row) * width;
+        uint8_t* dst = rgb.data() + static_cast<size_t>(row) * width * 3;
+        for (int i = 0; i < width; ++i) {
+            dst[3 * i + 0] = static_cast<uint8_t>(255.999f * std::sqrt(clamp01(src[i].x)));
+            dst[3 * i + 1] = static_cast<uint8_t>(255.999f * std::sqrt(clamp01(src[i].y)));
+            dst[3 * i + 2] = static_cast<uint8_t>(255.999f * std::sqrt(clamp01(src[i].z)));
+        }
+    });
+}
+
+// 整个文件在内存里拼好后一次写出
+inline bool writeFileBytes(const std::string& path, const std::vector<uint8_t>& header,
+                           const void* body, size_t body_bytes) {
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+    ofs.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    ofs.write(static_cast<const char*>(body), static_cast<std::streamsize>(body_bytes));
+    return static_cast<bool>(ofs);
+}
+
+inline std::vector<uint8_t> textHeader(const std::string& s) {
+    return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+inline bool writePPM(const std::string& path, const std::vector<uint8_t>& rgb, int width, int height) {
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    return writeFileBytes(path, textHeader(header), rgb.data(), rgb.size());
+}
+
+// PFM 从最下面一行开始存，正好是 framebuffer 的顺序；比例因子为负表示小端
+inline bool writePFM(const std::string& path, const std::vector<Vector3f>& framebuffer, int width, int height) {
+    const uint16_t probe = 1;
+    uint8_t first_byte;
+    std::memcpy(&first_byte, &probe, 1);
+    const bool little_endian = (first_byte == 1);
+
+    std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n" +
+                         (little_endian ? "-1.0\n" : "1.0\n");
+    std::vector<float> data(static_cast<size_t>(width) * height * 3);
+    for (size_t p = 0; p < static_cast<size_t>(width) * height; ++p) {
+        data[3 * p + 0] = framebuffer[p].x;
+        data[3 * p + 1] = framebuffer[p].y;
+        data[3 * p + 2] = framebuffer[p].z;
+    }
+    return writeFileBytes(path, textHeader(header), data.data(), data.size() * sizeof(float));
+}
+
+// 每行选一个 PNG 滤波器（None/Sub/Up/Average/Paeth），取残差绝对值之和最小的那个；各行并行
+inline std::vector<uint8_t> filterPNGRows(const std::vector<uint8_t>& rgb, int width, int height,
+                                          ThreadPool* pool) {
+    const size_t stride = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> out((stride + 1) * height);
+    forEachImageRow(height, pool, [&](int row) {
+        const uint8_t* cur = rgb.data() + row * stride;
+        const uint8_t* up = row > 0 ? cur - stride : nullptr;
+        std::vector<uint8_t> trial(stride), best(stride);
+        uint64_t best_cost = ~0ull;
+        uint8_t best_filter = 0;
+        for (uint8_t filter = 0; filter < 5; ++filter) {
+            uint64_t cost = 0;
+            for (size_t i = 0; i < stride; ++i) {
+                const int a = i >= 3 ? cur[i - 3] : 0;
+                const int b = up ? up[i] : 0;
+                const int c = (up && i >= 3) ? up[i - 3] : 0;
+                int pred = 0;
+                switch (filter) {
+                    case 1: pred = a; break;
+                    case 2: pred = b; break;
+                    case 3: pred = (a + b) / 2; break;
+                    case 4: {
+                        const int p = a + b - c;
+                        const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                        break;
+                    }
+                    default: break;
+                }
+                const uint8_t r = static_cast<uint8_t>(cur[i] - pred);
+                trial[i] = r;
+                cost += static_cast<uint64_t>(r < 128 ? r : 256 - r);
+            }
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_filter = filter;
+                best.swap(trial);
+            }
+        }
+        uint8_t* dst = out.data() + row * (stride + 1);
+        dst[0] = best_filter;
+        std::memcpy(dst + 1, best.data(), stride);
+    });
+    return out;
+}
+
+inline void appendPNGChunk(std::vector<uint8_t>& png, const char type[4], const uint8_t* data, size_t n) {
+    const uint32_t len = static_cast<uint32_t>(n);
+    for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(len >> shift));
+    const size_t type_pos = png.size();
+    png.insert(png.end(), type, type + 4);
+    if (n > 0) png.insert(png.end(), data, data + n);
+    const uint32_t crc = Deflate::crc32(png.data() + type_pos, n + 4);
+    for (int shift = 24; shift >= 0; shift -= 8) png.push_back(static_cast<uint8_t>(crc >> shift));
+}
+
+inline bool writePNG(const std::string& path, const std::vector<uint8_t>& rgb, int width, int height,
+                     ThreadPool* pool) {
+    std::vector<uint8_t> filtered = filterPNGRows(rgb, width, height, pool);
+    std::vector<uint8_t> idat = Deflate::zlibCompress(filtered.data(), filtered.size(), pool);
+
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<uint8_t> png(kSignature, kSignature + 8);
+    uint8_t ihdr[13] = {};
+    for (int k = 0; k < 4; ++k) {
+        ihdr[k] = static_cast<uint8_t>(static_cast<uint32_t>(width) >> (24 - 8 * k));
+        ihdr[4 + k] = static_cast<uint8_t>(static_cast<uint32_t>(height) >> (24 - 8 * k));
+    }
+    ihdr[8] = 8;  // 位深
+    ihdr[9] = 2;  // RGB
+    appendPNGChunk(png, "IHDR", ihdr, sizeof(ihdr));
+    appendPNGChunk(png, "IDAT", idat.data(), idat.size());
+    appendPNGChunk(png, "IEND", nullptr, 0);
+    return writeFileBytes(path, png, nullptr, 0);
+}
+
+// 已经量化好的 8 位图（例如样本数分布图）；PFM 没有意义，返回 false
+inline bool writeRGB8Image(const std::string& path, const std::vector<uint8_t>& rgb, int width, int height,
+                           ThreadPool* pool) {
+    ImageFormat format;
+    if (!imageFormatFromPath(path, format)) return false;
+    if (format == ImageFormat::PPM) return writePPM(path, rgb, width, height);
+    if (format == ImageFormat::PNG) return writePNG(path, rgb, width, height, pool);
+    return false;
+}
+
+// 按扩展名写出 framebuffer
+inline bool writeImage(const std::string& path, const std::vector<Vector3f>& framebuffer, int width, int height,
+                       ThreadPool* pool) {
+    ImageFormat format;
+    if (!imageFormatFromPath(path, format)) return false;
+    if (format == ImageFormat::PFM) return writePFM(path, framebuffer, width, height);
+    std::vector<uint8_t> rgb;
+    tonemapRGB8(framebuffer, width, height, rgb, pool);
+    return writeRGB8Image(path, rgb, width, height, pool);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include "Object.hpp"
+#include "Transform.hpp"
+
+// 实例：共享的底层几何（BLAS，例如一个 MeshTriangle 和它的 BVH）加上物体到世界的变换
+// 同一份几何可以被任意多个实例引用，只存一份；射线变换到物体空间求交，交点再变换回世界空间
+// 物体空间里的方向不做归一化，所以两个空间的 t 相同，可以直接和其他物体的交点比较；
+// 自交用的 EPSILON 按物体空间计算，缩放很大的实例要注意
+class Instance : public Object {
+public:
+    Instance(std::shared_ptr<const Object> geometry, const Transform& to_world)
+        : blas(std::move(geometry)), to_world(to_world) {}
+
+    const Object& geometry() const { return *blas; }
+    const Transform& transform() const { return to_world; }
+
+    // 移动实例后要调用 Scene::refitTopLevel（或 rebuildTopLevel），底层几何不需要重建
+    void setTransform(const Transform& t) { to_world = t; }
+
+    void finishLoading() const override { blas->finishLoading(); }
+
+    bool intersect(const Ray& ray, HitRecord& rec) const override {
+        if (!blas->intersect(toLocal(ray), rec)) return false;
+        toWorld(ray, rec);
+        return true;
+    }
+
+    bool occluded(const Ray& ray, float t_max) const override {
+        return blas->occluded(toLocal(ray), t_max);
+    }
+
+    // 整包变换到物体空间后交给底层几何，一致的包在仿射变换后仍然一致
+    uint32_t intersectPacket(RayPacket& packet, HitRecord* recs) const override {
+        RayPacket local = toLocal(packet);
+        uint32_t hits = blas->intersectPacket(local, recs);
+        for (uint32_t m = hits; m; m &= m - 1) {
+            int lane = simd::firstLane(m);
+            packet.t_max[lane] = local.t_max[lane];
+            toWorld(packet.ray(lane), recs[lane]);
+        }
+        return hits;
+    }
+
+    uint32_t occludedPacket(const RayPacket& packet) const override {
+        return blas->occludedPacket(toLocal(packet));
+    }
+
+    AABB bounds() const override {
+        return to_world.bounds(blas->bounds());
+    }
+
+private:
+    std::shared_ptr<const Object> blas;
+    Transform to_world;
+
+    Ray toLocal(const Ray& ray) const {
+        return Ray(to_world.inversePoint(ray.origin), to_world.inverseVector(ray.direction));
+    }
+
+    RayPacket toLocal(const RayPacket& packet) const {
+        RayPacket local;
+        for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+            local.clearLane(lane);
+            if (packet.active & (1u << lane)) {
+                local.set(lane, toLocal(packet.ray(lane)), packet.t_max[lane]);
+            }
+        }
+        return local;
+    }
+
+    // 底层几何给出的法线已经朝向物体空间的射线；法线按逆转置变换后与射线方向的点积符号不变，
+    // 所以 front_face 和朝向都不用重新判断。
+    // 面积元的缩放比例是 |det M| * |M^-T n|，uv 密度按它的平方根换算到世界空间
+    void toWorld(const Ray& ray, HitRecord& rec) const {
+        rec.p = ray.at(rec.t);
+        Vector3f n = to_world.normal(rec.N);
+        if (rec.uv_density > 0.0f) {
+            rec.uv_density /= std::sqrt(std::fabs(to_world.determinant()) * n.length());
+        }
+        rec.N = n.normalized();
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#  include <fstream>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+// 只读方式把整个文件映射进内存，析构时解除映射
+// 没有 mmap 的平台退回到整块读进来；两种情况下 data() 都至少按 64 字节对齐
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#if defined(_WIN32)
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (!ifs) return false;
+        length = static_cast<size_t>(ifs.tellg());
+        fallback.resize((length + sizeof(Chunk) - 1) / sizeof(Chunk));
+        ifs.seekg(0);
+        if (length > 0 && !ifs.read(reinterpret_cast<char*>(fallback.data()), length)) {
+            close();
+            return false;
+        }
+        base = reinterpret_cast<const unsigned char*>(fallback.data());
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            base = static_cast<const unsigned char*>(p);
+        }
+        // 映射建立后文件描述符就可以关掉了
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    void close() {
+#if defined(_WIN32)
+        fallback.clear();
+        fallback.shrink_to_fit();
+#else
+        if (base && length > 0) {
+            ::munmap(const_cast<unsigned char*>(base), length);
+        }
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return base; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t length = 0;
+#if defined(_WIN32)
+    struct alignas(64) Chunk { unsigned char bytes[64]; };
+    std::vector<Chunk> fallback;
+#endif
+};
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <memory>
 #include "global.hpp"
-#include "stb_image.h"
+#include "Sampler.hpp"
+#include "Texture.hpp"
 
 enum class MaterialType {
     DIFFUSE,
@@ -40,10 +42,12 @@ public:
 
     //     return albedo * (1.0f / PI);
     // }
+    // uv_footprint 是交点处取样区域在 uv 空间的宽度，用来选贴图的 mip 层
     Vector3f eval(const Vector3f& wi,
               const Vector3f& wo,
               const Vector3f& N,
-              const Vector2f& uv) const
+              const Vector2f& uv,
+              float uv_footprint = 0.0f) const
     {
         if (dot(N, wi) <= 0.0f || dot(N, wo) <= 0.0f) {
             return Vector3f(0.0f);
@@ -52,7 +56,7 @@ public:
         // 漫反射部分（Lambert）
         Vector3f albedo = m_color;
         if (has_texture) {
-            albedo = sampleTexture(uv.x, uv.y);
+            albedo = sampleTexture(uv.x, uv.y, uv_footprint);
         }
         Vector3f f_diffuse = Vector3f(0.0f);
         if (m_type == MaterialType::DIFFUSE || m_type == MaterialType::PHONG) {
@@ -102,50 +106,35 @@ public:
     //     pdf = dot(N, dir) / PI;
     //     return dir;
     // }
-    Vector3f sample(const Vector3f& N, float& pdf) const {
-        if (m_type == MaterialType::DIFFUSE) {
-            // 余弦加权半球采样
-            float r1 = 2.0f * PI * randFloat();
-            float r2 = randFloat();
-            float r2s = std::sqrt(r2);
-
-            float x = std::cos(r1) * r2s;
-            float y = std::sin(r1) * r2s;
-            float z = std::sqrt(1.0f - r2);
-
-            Vector3f w = N;
-            Vector3f a = (std::fabs(w.x) > 0.1f) ? Vector3f(0.0f, 1.0f, 0.0f) : Vector3f(1.0f, 0.0f, 0.0f);
-            Vector3f v = cross(w, a).normalized();
-            Vector3f u = cross(v, w);
-
-            Vector3f dir = (u * x + v * y + w * z).normalized();
-            pdf = dot(N, dir) / PI;
-            return dir;
+    // PHONG 材质按 diffuse / specular 两个 lobe 的混合分布采样：
+    // 以 specularProbability() 的概率对 Blinn-Phong 高光 lobe 做重要性采样，否则余弦半球采样
+    // 从 sampler 的当前维度依次取 lobe（1D）和方向（2D），调用方负责先 setDimension
+    Vector3f sample(const Vector3f& N, const Vector3f& wo, float& pdf, Sampler& sampler) const {
+        if (m_type != MaterialType::DIFFUSE && m_type != MaterialType::PHONG) {
+            pdf = 0.0f;
+            return N;
         }
 
-        if (m_type == MaterialType::PHONG) {
-            // 这里做一个简单版本：仍然用余弦半球采样
-            // （严格来说应该对高光 lobe 采样，但为了先看到效果，先沿用 diffuse 的采样）
-            float r1 = 2.0f * PI * randFloat();
-            float r2 = randFloat();
+        float spec_prob = specularProbability();
+        Vector3f dir;
+        float lobe = sampler.get1D();
+        Vector2f u = sampler.get2D();
+        float r1 = 2.0f * PI * u.x;
+        float r2 = u.y;
+        if (spec_prob > 0.0f && lobe < spec_prob) {
+            // 半程向量按 (n+1)/(2π) cos^n θh 分布采样，再把 wo 关于 h 反射
+            float cos_h = std::pow(r2, 1.0f / (m_phong_exp + 1.0f));
+            float sin_h = std::sqrt(std::max(0.0f, 1.0f - cos_h * cos_h));
+            Vector3f h = toWorld(Vector3f(std::cos(r1) * sin_h, std::sin(r1) * sin_h, cos_h), N);
+            dir = (h * (2.0f * dot(wo, h)) - wo).normalized();
+        } else {
+            // 余弦加权半球采样
             float r2s = std::sqrt(r2);
-
-            float x = std::cos(r1) * r2s;
-            float y = std::sin(r1) * r2s;
-            float z = std::sqrt(1.0f - r2);
-
-            Vector3f w = N;
-            Vector3f a = (std::fabs(w.x) > 0.1f) ? Vector3f(0.0f, 1.0f, 0.0f) : Vector3f(1.0f, 0.0f, 0.0f);
-            Vector3f v = cross(w, a).normalized();
-            Vector3f u = cross(v, w);
-
-            Vector3f dir = (u * x + v * y + w * z).normalized();
-            pdf = dot(N, dir) / PI;
-            return dir;
+            dir = toWorld(Vector3f(std::cos(r1) * r2s, std::sin(r1) * r2s, std::sqrt(1.0f - r2)), N).normalized();
         }
 
-        pdf = 0.0f;
-        return N;
+        pdf = this->pdf(dir, wo, N);
+        return dir;
     }
 
 
@@ -154,50 +143,83 @@ public:
     //     if (cos_theta <= 0.0f) return 0.0f;
     //     return cos_theta / PI;
     // }
-    float pdf(const Vector3f& wi, const Vector3f& N) const {
+    // 与 sample 对应的方向 pdf（立体角测度），MIS 时也用它给光源采样算权重
+    float pdf(const Vector3f& wi, const Vector3f& wo, const Vector3f& N) const {
         float cos_theta = dot(N, wi);
         if (cos_theta <= 0.0f) return 0.0f;
 
-        // 当前 sample 对 DIFFUSE 和 PHONG 都使用余弦半球采样
-        return cos_theta / PI;
+        float pdf_diffuse = cos_theta / PI;
+        float spec_prob = specularProbability();
+        if (spec_prob <= 0.0f) {
+            return pdf_diffuse;
+        }
+
+        // 半程向量的 pdf 换算到 wi：p(wi) = p(h) / (4 |wo·h|)
+        float pdf_spec = 0.0f;
+        Vector3f h = (wi + wo).normalized();
+        float nh = dot(N, h);
+        float oh = std::fabs(dot(wo, h));
+        if (nh > 0.0f && oh > 0.0f) {
+            float pdf_h = (m_phong_exp + 1.0f) / (2.0f * PI) * std::pow(nh, m_phong_exp);
+            pdf_spec = pdf_h / (4.0f * oh);
+        }
+        return (1.0f - spec_prob) * pdf_diffuse + spec_prob * pdf_spec;
+    }
+
+    // 采样高光 lobe 的概率：按 Ks 与 Kd 的平均值分配
+    float specularProbability() const {
+        if (m_type != MaterialType::PHONG || m_phong_exp <= 0.0f) return 0.0f;
+        float ks = (m_specular.x + m_specular.y + m_specular.z) / 3.0f;
+        float kd = (m_color.x + m_color.y + m_color.z) / 3.0f;
+        if (ks <= 0.0f) return 0.0f;
+        return ks / (ks + kd);
     }
 
+    // 贴图由 TextureManager 统一解码和缓存，引用同一文件的材质共享一份
     bool loadTexture(const std::string& path) {
-        if (tex_data) {
-            stbi_image_free(tex_data);
-            tex_data = nullptr;
-        }
-        tex_data = stbi_load(path.c_str(), &tex_width, &tex_height, &tex_channels, 0);
-        if (!tex_data) {
-            std::cerr << "Failed to load texture: " << path << std::endl;
-            has_texture = false;
-            return false;
-        }
-        has_texture = true;
+        loadTextureAsync(path, nullptr);
+        finishTextureLoad();
+        return has_texture;
+    }
+
+    // 只提交解码，渲染前必须调用 finishTextureLoad()（Scene::commit 经 Object::finishLoading 调用）
+    void loadTextureAsync(const std::string& path, ThreadPool* pool) {
+        pending_texture = TextureManager::instance().loadAsync(path, pool);
         tex_path = path;
-        return true;
     }
 
-    Vector3f sampleTexture(float u, float v) const {
-        if (!has_texture || !tex_data || tex_width <= 0 || tex_height <= 0) {
+    // 等待异步解码完成；失败时材质退回 m_color，tex_path 仍保留
+    void finishTextureLoad() {
+        if (!pending_texture.valid()) return;
+        texture = pending_texture.get();
+        pending_texture = TextureManager::Handle();
+        has_texture = (texture != nullptr);
+    }
+
+    // 贴图的线性颜色；按 footprint 做三线性过滤
+    Vector3f sampleTexture(float u, float v, float uv_footprint = 0.0f) const {
+        if (!texture) {
             return m_color;
         }
+        return texture->sample(u, v, uv_footprint);
+    }
+
+    // 降噪用的反照率：漫反射颜色（有贴图时取贴图）加上高光颜色，限制在 [0,1]；
+    // 光源按白色处理，降噪时自发光原样保留
+    Vector3f albedo(const Vector2f& uv, float uv_footprint = 0.0f) const {
+        if (isEmissive()) return Vector3f(1.0f);
+        Vector3f a = has_texture ? sampleTexture(uv.x, uv.y, uv_footprint) : m_color;
+        if (m_type == MaterialType::PHONG) a += m_specular;
+        return Vector3f(clamp01(a.x), clamp01(a.y), clamp01(a.z));
+    }
 
-        u = u - std::floor(u);
-        v = v - std::floor(v);
-        if (u < 0) u += 1.0f;
-        if (v < 0) v += 1.0f;
-
-        int x = static_cast<int>(u * tex_width);
-        int y = static_cast<int>((1.0f - v) * tex_height);
-        if (x >= tex_width) x = tex_width - 1;
-        if (y >= tex_height) y = tex_height - 1;
-
-        int idx = (y * tex_width + x) * tex_channels;
-        float r = tex_data[idx] / 255.0f;
-        float g = tex_data[idx + 1] / 255.0f;
-        float b = tex_data[idx + 2] / 255.0f;
-        return Vector3f(r, g, b);
+    // 局部坐标（z 轴为 N）转到世界坐标
+    static Vector3f toWorld(const Vector3f& local, const Vector3f& N) {
+        Vector3f w = N;
+        Vector3f a = (std::fabs(w.x) > 0.1f) ? Vector3f(0.0f, 1.0f, 0.0f) : Vector3f(1.0f, 0.0f, 0.0f);
+        Vector3f v = cross(w, a).normalized();
+        Vector3f u = cross(v, w);
+        return u * local.x + v * local.y + w * local.z;
     }
 
     Vector3f m_color;
@@ -206,9 +228,9 @@ public:
     bool m_two_sided;
 
     bool has_texture = false;
-    unsigned char* tex_data = nullptr;
-    int tex_width = 0, tex_height = 0, tex_channels = 0;
-    std::string tex_path;
+    std::shared_ptr<const Texture> texture;
+    TextureManager::Handle pending_texture;  // loadTextureAsync 之后、finishTextureLoad 之前有效
+    std::string tex_path;  // 请求过的贴图路径（MTL 的 map_Kd），解码失败时也保留
     // 高光参数（用于 PHONG）
     Vector3f m_specular = Vector3f(0.0f); // 高光颜色（来自 Ks）
     float    m_phong_exp = 0.0f;         // 高光指数（来自 Ns）
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Buffer.hpp"
+#include "MappedFile.hpp"
+
+// 网格缓存文件（<obj>.ptcache）的格式：
+//   文件头：魔数、版本、BVH 宽度和构建方式、几个结构体的大小、源文件的内容哈希、各段的位置
+//   之后是各段数据，每段按 64 字节对齐，可以 mmap 后直接当数组用，不做拷贝
+// 版本、宽度、构建方式、结构体大小、哈希任何一个对不上都当作过期，重新解析并覆盖缓存
+
+static constexpr char kMeshCacheMagic[8] = {'P', 'T', 'M', 'E', 'S', 'H', '\0', '\0'};
+// 段的内容或含义变了就加一
+static constexpr uint32_t kMeshCacheVersion = 2;
+static constexpr size_t kMeshCacheAlign = 64;
+
+enum MeshCacheSection : uint32_t {
+    kCachePositions,
+    kCacheTexcoords,
+    kCacheIndices,
+    kCacheUvIndices,
+    kCacheMaterialIds,
+    kCacheEmissiveFaces,
+    kCacheBvhNodes,
+    kCacheBvhPrims,
+    kCacheWideNodes,   // PT_BVH_WIDTH 为 2 时为空
+    kCacheWideBlocks,
+    kCacheMaterials,   // MeshCacheMaterial 数组
+    kCacheStrings,     // 材质名、贴图路径，不带结尾的 0
+    kCacheSectionCount
+};
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bvh_width;
+    uint32_t bvh_quality;   // BVHQuality，换了构建方式也要重建
+    uint32_t layout[4];     // 各段元素类型的 sizeof，换了编译器或结构体改了也能发现
+    uint64_t source_hash;
+    float total_emissive_area;
+    uint32_t section_count;
+    struct Range {
+        uint64_t offset;
+        uint64_t bytes;
+    } sections[kCacheSectionCount];
+};
+
+// 材质参数；按场景名加上的发光、PHONG 修正都已经算进去了
+struct MeshCacheMaterial {
+    float color[3];
+    float emission[3];
+    float specular[3];
+    float phong_exp;
+    uint32_t type;
+    uint32_t two_sided;
+    uint32_t name_offset, name_length;       // 在 kCacheStrings 里的位置
+    uint32_t texture_offset, texture_length; // 长度为 0 表示没有贴图
+};
+
+// 64 位哈希，每次吃 8 个字节；只用来判断源文件有没有变，不需要抗碰撞
+inline uint64_t hashMix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t hashBytes(const void* data, size_t n, uint64_t h) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const uint64_t k = 0x9e3779b97f4a7c15ull;
+    h ^= n * k;
+    while (n >= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ hashMix64(w)) * k;
+        h = (h << 31) | (h >> 33);
+        p += 8;
+        n -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, n);
+    return hashMix64(h ^ tail ^ (static_cast<uint64_t>(n) << 56));
+}
+
+inline std::string objBaseDir(const std::string& obj_path) {
+    auto slash_pos = obj_path.find_last_of("/\\");
+    return (slash_pos == std::string::npos) ? std::string(".") : obj_path.substr(0, slash_pos);
+}
+
+// OBJ、它引用的所有 mtl 文件和 OBJ 路径本身（材质的修正规则看路径里的场景名）一起决定缓存内容
+// OBJ 读不到时返回 false；mtl 缺失也计入哈希，补上文件后缓存会失效
+inline bool hashMeshSources(const std::string& obj_path, uint64_t& hash) {
+    MappedFile obj;
+    if (!obj.open(obj_path)) return false;
+
+    uint64_t h = hashBytes(obj_path.data(), obj_path.size(), 0);
+    const char* text = reinterpret_cast<const char*>(obj.data());
+    const size_t size = obj.size();
+    h = hashBytes(text, size, h);
+
+    const std::string basedir = objBaseDir(obj_path);
+    size_t line = 0;
+    while (line < size) {
+        const char* nl = static_cast<const char*>(std::memchr(text + line, '\n', size - line));
+        const size_t end = nl ? static_cast<size_t>(nl - text) : size;
+        size_t p = line;
+        while (p < end && (text[p] == ' ' || text[p] == '\t')) ++p;
+        if (end - p > 7 && std::memcmp(text + p, "mtllib", 6) == 0 &&
+            (text[p + 6] == ' ' || text[p + 6] == '\t')) {
+            p += 7;
+            // 一行可以列多个 mtl 文件
+            while (p < end) {
+                while (p < end && (text[p] == ' ' || text[p] == '\t' || text[p] == '\r')) ++p;
+                size_t q = p;
+                while (q < end && text[q] != ' ' && text[q] != '\t' && text[q] != '\r') ++q;
+                if (q > p) {
+                    const std::string name(text + p, q - p);
+                    MappedFile mtl;
+                    h = hashBytes(name.data(), name.size(), h);
+                    if (mtl.open(basedir + "/" + name)) {
+                        h = hashBytes(mtl.data(), mtl.size(), h);
+                    } else {
+                        h = hashMix64(h ^ 0xdeadull);
+                    }
+                }
+                p = q;
+            }
+        }
+        line = end + 1;
+    }
+    hash = h;
+    return true;
+}
+
+// 先在内存里拼好整个文件，再写到临时文件后改名，其他进程不会读到写了一半的缓存
+class MeshCacheWriter {
+public:
+    MeshCacheWriter() {
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMeshCacheMagic, sizeof(header.magic));
+        header.version = kMeshCacheVersion;
+        header.section_count = kCacheSectionCount;
+        bytes.resize(alignUp(sizeof(MeshCacheHeader)));
+    }
+
+    MeshCacheHeader header;
+
+    template <typename T>
+    void section(MeshCacheSection id, const T* data, size_t count) {
+        const size_t offset = bytes.size();
+        const size_t n = count * sizeof(T);
+        bytes.resize(alignUp(offset + n));
+        if (n > 0) std::memcpy(bytes.data() + offset, data, n);
+        header.sections[id].offset = offset;
+        header.sections[id].bytes = n;
+    }
+
+    bool write(const std::string& path) {
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!ofs) return false;
+            ofs.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            if (!ofs) {
+                ofs.close();
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<char> bytes;
+
+    static size_t alignUp(size_t n) { return (n + kMeshCacheAlign - 1) / kMeshCacheAlign * kMeshCacheAlign; }
+};
+
+// 映射缓存文件并检查文件头；各段以 Buffer 视图的形式取出，映射由 release() 交给调用者保管
+class MeshCacheReader {
+public:
+    // layout / width / quality 与写入时用同样的方式算，任何一项不同都视为过期
+    bool open(const std::string& path, uint64_t source_hash, uint32_t bvh_width, uint32_t bvh_quality,
+              const uint32_t layout[4]) {
+        file.reset(new MappedFile());
+        if (!file->open(path) || file->size() < sizeof(MeshCacheHeader)) return false;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (std::memcmp(header.magic, kMeshCacheMagic, sizeof(header.magic)) != 0 ||
+            header.version != kMeshCacheVersion ||
+            header.bvh_width != bvh_width ||
+            header.bvh_quality != bvh_quality ||
+            std::memcmp(header.layout, layout, sizeof(header.layout)) != 0 ||
+            header.source_hash != source_hash ||
+            header.section_count != kCacheSectionCount) {
+            return false;
+        }
+        for (const auto& s : header.sections) {
+            if (s.offset % kMeshCacheAlign != 0 || s.offset > file->size() ||
+                s.bytes > file->size() - s.offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const MeshCacheHeader& getHeader() const { return header; }
+
+    // 段的大小不是 sizeof(T) 的整数倍时 ok 置为 false
+    template <typename T>
+    Buffer<T> view(MeshCacheSection id, bool& ok) const {
+        const auto& s = header.sections[id];
+        if (s.bytes % sizeof(T) != 0) {
+            ok = false;
+            return Buffer<T>();
+        }
+        return Buffer<T>::view(reinterpret_cast<const T*>(file->data() + s.offset), s.bytes / sizeof(T));
+    }
+
+    std::unique_ptr<MappedFile> release() { return std::move(file); }
+
+private:
+    std::unique_ptr<MappedFile> file;
+    MeshCacheHeader header;
+};
@@ -1,12 +1,28 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include "Object.hpp"
 #include "Triangle.hpp"
 #include "Material.hpp"
-#include "tiny_obj_loader.h"
+#include "BVH.hpp"
+#include "WideBVH.hpp"
+#include "Buffer.hpp"
+#include "MeshCache.hpp"
+#include "ObjLoader.hpp"
+
+// 网格加载选项
+struct MeshLoadOptions {
+    bool use_cache = true;                      // 读写 <obj>.ptcache
+    BVHQuality bvh_quality = BVHQuality::Binned;
+    ThreadPool* pool = nullptr;                 // 为空时单线程构建 BVH
+    bool verbose = true;                        // 打印加载时间、BVH 统计等
+};
 
 class MeshTriangle : public Object {
 public:
@@ -15,60 +31,180 @@ public:
     //     loadObj(obj_path);
     // }
 
-    MeshTriangle(const std::string& obj_path):obj_path_(obj_path)
+    // use_cache 为真时先找 <obj>.ptcache：内容哈希对得上就直接映射，跳过解析和建 BVH；
+    // 没有缓存或已过期则解析 OBJ，再把结果写回缓存
+    MeshTriangle(const std::string& obj_path, const MeshLoadOptions& options = MeshLoadOptions())
+        : options_(options), obj_path_(obj_path)
     {
-        loadObj(obj_path);
+        auto t_start = std::chrono::high_resolution_clock::now();
+
+        uint64_t source_hash = 0;
+        const bool hashed = options.use_cache && hashMeshSources(obj_path, source_hash);
+        const std::string cache_path = obj_path + ".ptcache";
+        from_cache = hashed && loadCache(cache_path, source_hash);
+        if (!from_cache) {
+            loadObj(obj_path);
+            if (hashed && faceCount() > 0 && !writeCache(cache_path, source_hash)) {
+                std::cerr << "Warning: could not write mesh cache " << cache_path << std::endl;
+            }
+        }
+
+        auto t_end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> elapsed = t_end - t_start;
+        load_ms = elapsed.count();
+        if (!options.verbose) return;
+        if (faceCount() > 0) printSummary(from_cache ? cache_path : obj_path);
+        std::cout << "Mesh load time: " << elapsed.count() << " ms"
+                  << (from_cache ? " (cache hit)" : (hashed ? " (cache rebuilt)" : "")) << std::endl;
     }
 
     bool intersect(const Ray& ray, HitRecord& rec) const override {
-        bool hit_anything = false;
-        for (const auto& tri : triangles) {
-            if (tri->intersect(ray, rec)) {
-                hit_anything = true;
+        PrimitiveHit hit;
+        hit.t = rec.t;
+#if PT_BVH_WIDTH > 2
+        bool found = wide_bvh.intersect(ray, hit);
+#else
+        bool found = bvh.intersect(ray, hit, [&](uint32_t prim) {
+            Vector3f v0, v1, v2;
+            getFaceVertices(prim, v0, v1, v2);
+            float t, u, v;
+            if (!intersectTriangle(ray, v0, v1 - v0, v2 - v0, hit.t, t, u, v)) {
+                return false;
             }
+            hit.t = t;
+            hit.prim = prim;
+            hit.u = u;
+            hit.v = v;
+            return true;
+        });
+#endif
+        if (!found) return false;
+
+        finalizeHit(ray, hit, rec);
+        return true;
+    }
+
+    bool occluded(const Ray& ray, float t_max) const override {
+#if PT_BVH_WIDTH > 2
+        return wide_bvh.occluded(ray, t_max);
+#else
+        return bvh.occluded(ray, t_max, [&](uint32_t prim) {
+            Vector3f v0, v1, v2;
+            getFaceVertices(prim, v0, v1, v2);
+            float t, u, v;
+            return intersectTriangle(ray, v0, v1 - v0, v2 - v0, t_max, t, u, v);
+        });
+#endif
+    }
+
+    // 光线包遍历（SIMD 跨射线），每个三角形一次测完整包
+    uint32_t intersectPacket(RayPacket& packet, HitRecord* recs) const override {
+        PacketHit hits;
+#if PT_BVH_WIDTH > 2
+        uint32_t found = wide_bvh.intersectPacket(packet, hits);
+#else
+        constexpr int K = RayPacket::kSize;
+        uint32_t found = 0;
+        bvh.intersectPacket(packet, [&](uint32_t prim, uint32_t mask) {
+            Vector3f v0, v1, v2;
+            getFaceVertices(prim, v0, v1, v2);
+            RayPacket::vfloat t, u, v;
+            uint32_t hit = intersectTrianglePacket(packet, v0, v1 - v0, v2 - v0, t, u, v) & mask;
+            if (!hit) return;
+
+            alignas(32) float ts[K], us[K], vs[K];
+            t.store(ts);
+            u.store(us);
+            v.store(vs);
+            for (uint32_t m = hit; m; m &= m - 1) {
+                int lane = simd::firstLane(m);
+                packet.t_max[lane] = ts[lane];
+                hits.prim[lane] = prim;
+                hits.u[lane] = us[lane];
+                hits.v[lane] = vs[lane];
+            }
+            found |= hit;
+        });
+#endif
+
+        for (uint32_t m = found; m; m &= m - 1) {
+            int lane = simd::firstLane(m);
+            PrimitiveHit hit;
+            hit.t = packet.t_max[lane];
+            hit.prim = hits.prim[lane];
+            hit.u = hits.u[lane];
+            hit.v = hits.v[lane];
+            finalizeHit(packet.ray(lane), hit, recs[lane]);
         }
-        return hit_anything;
+        return found;
     }
 
-    bool isEmissive() const override {
-        // 整个 mesh 不作为单独光源使用，光源由 emissive_tris 提供
-        return false;
+    uint32_t occludedPacket(const RayPacket& packet) const override {
+#if PT_BVH_WIDTH > 2
+        return wide_bvh.occludedPacket(packet);
+#else
+        return bvh.occludedPacket(packet, [&](uint32_t prim, uint32_t mask) {
+            Vector3f v0, v1, v2;
+            getFaceVertices(prim, v0, v1, v2);
+            RayPacket::vfloat t, u, v;
+            return intersectTrianglePacket(packet, v0, v1 - v0, v2 - v0, t, u, v) & mask;
+        });
+#endif
     }
 
-    // 将内部所有发光三角形加入外部 lights 列表
-    void collectEmissiveTriangles(std::vector<Object*>& out_lights) const {
-        for (auto tri : emissive_tris) {
-            out_lights.push_back(tri);
+    AABB bounds() const override { return bvh.bounds(); }
+
+    // 等待加载时提交的贴图解码；verbose 时报告主线程实际等了多久（解码没被建 BVH 盖住的部分）
+    void finishLoading() const override {
+        auto t_start = std::chrono::high_resolution_clock::now();
+        int pending = 0;
+        for (Material* mat : materials) {
+            if (!mat->pending_texture.valid()) continue;
+            mat->finishTextureLoad();
+            ++pending;
         }
+        if (!options_.verbose || pending == 0) return;
+        std::chrono::duration<double, std::milli> waited = std::chrono::high_resolution_clock::now() - t_start;
+        std::cout << "Texture wait: " << waited.count() << " ms (" << pending << " materials)" << std::endl;
+    }
+
+    bool isEmissive() const override {
+        // 整个 mesh 不作为单独光源使用，光源由 emissive_faces 提供
+        return false;
     }
 
     ~MeshTriangle() override {
-        for (auto tri : triangles) {
-            delete tri;
-        }
         for (auto m : materials) {
             delete m;
         }
     }
 
+    size_t faceCount() const { return material_ids.size(); }
+
+    void getFaceVertices(uint32_t face, Vector3f& v0, Vector3f& v1, Vector3f& v2) const {
+        const uint32_t* idx = &indices[3 * face];
+        v0 = positions[idx[0]];
+        v1 = positions[idx[1]];
+        v2 = positions[idx[2]];
+    }
+
+    Material* getFaceMaterial(uint32_t face) const {
+        int id = material_ids[face];
+        return (id >= 0) ? materials[id] : nullptr;
+    }
+
     // 调试用：打印 AABB
     void printAABB() const {
         Vector3f min_v( std::numeric_limits<float>::max());
         Vector3f max_v(-std::numeric_limits<float>::max());
 
-        for (auto tri : triangles) {
-            const Vector3f& a = tri->getV0();
-            const Vector3f& b = tri->getV1();
-            const Vector3f& c = tri->getV2();
-            auto update = [&](const Vector3f& p) {
-                min_v.x = std::min(min_v.x, p.x);
-                min_v.y = std::min(min_v.y, p.y);
-                min_v.z = std::min(min_v.z, p.z);
-                max_v.x = std::max(max_v.x, p.x);
-                max_v.y = std::max(max_v.y, p.y);
-                max_v.z = std::max(max_v.z, p.z);
-            };
-            update(a); update(b); update(c);
+        for (const auto& p : positions) {
+            min_v.x = std::min(min_v.x, p.x);
+            min_v.y = std::min(min_v.y, p.y);
+            min_v.z = std::min(min_v.z, p.z);
+            max_v.x = std::max(max_v.x, p.x);
+            max_v.y = std::max(max_v.y, p.y);
+            max_v.z = std::max(max_v.z, p.z);
         }
 
         std::cout << "Mesh AABB: min(" << min_v.x << ", " << min_v.y << ", " << min_v.z
@@ -78,46 +214,363 @@ public:
     // 用于采样光源时的总面积
     float emissiveAreaSum() const { return total_emissive_area; }
 
-    const std::vector<Triangle*>& getEmissiveTris() const { return emissive_tris; }
+    // 发光面的下标，Scene 据此建立光源表
+    const Buffer<uint32_t>& getEmissiveFaces() const { return emissive_faces; }
+
+    // 构造用的总时间（含 BVH 构建）和其中建 BVH 的时间，毫秒；从缓存加载时不建 BVH
+    double loadMillis() const { return load_ms; }
+    double buildMillis() const { return build_ms; }
+    bool loadedFromCache() const { return from_cache; }
 
 private:
-    std::vector<Triangle*> triangles;
+    // 扁平化的索引网格：顶点/UV 在各面之间共享，每个面只存下标
+    // 从缓存加载时这些数组直接指向 cache_file 的映射
+    Buffer<Vector3f> positions;
+    Buffer<Vector2f> texcoords;
+    Buffer<uint32_t> indices;     // 每面 3 个，指向 positions
+    Buffer<int32_t>  uv_indices;  // 每面 3 个，指向 texcoords；-1 表示该面没有 UV
+    Buffer<int32_t>  material_ids; // 每面 1 个，-1 表示无材质
+
     std::vector<Material*> materials;
     std::unordered_map<std::string, int> mtlname_to_id;
+    BVH bvh;
+#if PT_BVH_WIDTH > 2
+    // 遍历用的宽 BVH，由 bvh 折叠而来；PT_BVH_WIDTH 为 2 时直接遍历二叉 BVH
+    WideBVH<PT_BVH_WIDTH> wide_bvh;
+#endif
 
-    std::vector<Triangle*> emissive_tris;
+    Buffer<uint32_t> emissive_faces;
     float total_emissive_area = 0.0f;
 
+    std::unique_ptr<MappedFile> cache_file;
+
+    MeshLoadOptions options_;
     std::string obj_path_;
+    double load_ms = 0.0;
+    double build_ms = 0.0;
+    bool from_cache = false;
     // std::string light_mtl_name;
     // Vector3f light_radiance;
 
-    void loadObj(const std::string& obj_path) {
-        tinyobj::ObjReaderConfig reader_config;
-        // 让 tinyobj 去 obj 所在目录找 mtl
-        std::string basedir = ".";
-        auto slash_pos = obj_path.find_last_of("/\\");
-        if (slash_pos != std::string::npos) {
-            basedir = obj_path.substr(0, slash_pos);
+    // 只对最终的最近交点计算位置、法线、UV 和材质
+    void finalizeHit(const Ray& ray, const PrimitiveHit& hit, HitRecord& rec) const {
+        const uint32_t face = hit.prim;
+        const float u = hit.u;
+        const float v = hit.v;
+
+        Vector3f v0, v1, v2;
+        getFaceVertices(face, v0, v1, v2);
+        Vector3f edge1 = v1 - v0;
+        Vector3f edge2 = v2 - v0;
+
+        rec.t = hit.t;
+        rec.p = ray.at(hit.t);
+
+        Vector3f face_normal = cross(edge1, edge2);
+        Vector3f outward_normal = face_normal.normalized();
+        rec.set_face_normal(ray, outward_normal);
+
+        const int32_t* uv_idx = &uv_indices[3 * face];
+        if (uv_idx[0] >= 0) {
+            const Vector2f& uv0 = texcoords[uv_idx[0]];
+            const Vector2f& uv1 = texcoords[uv_idx[1]];
+            const Vector2f& uv2 = texcoords[uv_idx[2]];
+            float w = 1.0f - u - v;
+            rec.uv = Vector2f(
+                w * uv0.x + u * uv1.x + v * uv2.x,
+                w * uv0.y + u * uv1.y + v * uv2.y
+            );
+            // 两个面积都是平行四边形的，比值与三角形的相同
+            float uv_area = std::fabs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y));
+            float area = face_normal.length();
+            rec.uv_density = (area > 0.0f) ? std::sqrt(uv_area / area) : 0.0f;
+        } else {
+            rec.uv = Vector2f(0.0f, 0.0f);
+            rec.uv_density = 0.0f;
         }
-        reader_config.mtl_search_path = basedir;
 
-        tinyobj::ObjReader reader;
+        rec.material = getFaceMaterial(face);
+    }
+
+    void buildBVH() {
+        auto t_start = std::chrono::high_resolution_clock::now();
+        std::vector<AABB> prim_bounds(faceCount());
+        for (uint32_t f = 0; f < faceCount(); ++f) {
+            Vector3f v0, v1, v2;
+            getFaceVertices(f, v0, v1, v2);
+            prim_bounds[f].expand(v0);
+            prim_bounds[f].expand(v1);
+            prim_bounds[f].expand(v2);
+        }
+        bvh.build(prim_bounds, options_.bvh_quality, options_.pool);
+#if PT_BVH_WIDTH > 2
+        wide_bvh.build(bvh, [this](uint32_t face, Vector3f& v0, Vector3f& v1, Vector3f& v2) {
+            getFaceVertices(face, v0, v1, v2);
+        });
+#endif
+        auto t_end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> elapsed = t_end - t_start;
+        build_ms = elapsed.count();
+        if (!options_.verbose) return;
+        std::cout << "BVH build: " << elapsed.count() << " ms ("
+                  << bvhQualityName(options_.bvh_quality) << ", "
+                  << (options_.pool ? options_.pool->size() : 1) << " threads)" << std::endl;
+    }
+
+    void printSummary(const std::string& source) const {
+        std::cout << "BVH nodes: " << bvh.nodeCount() << ", SAH cost: " << bvh.sahCost() << std::endl;
+#if PT_BVH_WIDTH > 2
+        std::cout << "BVH" << PT_BVH_WIDTH << " nodes: " << wide_bvh.nodeCount()
+                  << ", triangle blocks: " << wide_bvh.blockCount() << std::endl;
+#endif
+        std::cout << "Loaded OBJ: " << source
+                  << " with " << faceCount() << " triangles, "
+                  << positions.size() << " vertices." << std::endl;
+        printAABB();
+        std::cout << "Emissive tris: " << emissive_faces.size()
+                  << ", total emissive area: " << total_emissive_area << std::endl;
+    }
+
+    // 缓存里各段元素类型的大小，编译选项或结构体变了缓存就失效
+    static void cacheLayout(uint32_t layout[4]) {
+        layout[0] = sizeof(Vector3f);
+        layout[1] = sizeof(BVHNode);
+#if PT_BVH_WIDTH > 2
+        layout[2] = sizeof(WideBVH<PT_BVH_WIDTH>::Node);
+        layout[3] = sizeof(WideBVH<PT_BVH_WIDTH>::TriangleBlock);
+#else
+        layout[2] = 0;
+        layout[3] = 0;
+#endif
+    }
 
-        if (!reader.ParseFromFile(obj_path, reader_config)) {
-            if (!reader.Error().empty()) {
-                std::cerr << "TinyObjReader: " << reader.Error() << std::endl;
+    bool writeCache(const std::string& path, uint64_t source_hash) const {
+        MeshCacheWriter writer;
+        writer.header.bvh_width = PT_BVH_WIDTH;
+        writer.header.bvh_quality = static_cast<uint32_t>(options_.bvh_quality);
+        cacheLayout(writer.header.layout);
+        writer.header.source_hash = source_hash;
+        writer.header.total_emissive_area = total_emissive_area;
+
+        writer.section(kCachePositions, positions.data(), positions.size());
+        writer.section(kCacheTexcoords, texcoords.data(), texcoords.size());
+        writer.section(kCacheIndices, indices.data(), indices.size());
+        writer.section(kCacheUvIndices, uv_indices.data(), uv_indices.size());
+        writer.section(kCacheMaterialIds, material_ids.data(), material_ids.size());
+        writer.section(kCacheEmissiveFaces, emissive_faces.data(), emissive_faces.size());
+        writer.section(kCacheBvhNodes, bvh.getNodes().data(), bvh.getNodes().size());
+        writer.section(kCacheBvhPrims, bvh.primIndices().data(), bvh.primIndices().size());
+#if PT_BVH_WIDTH > 2
+        writer.section(kCacheWideNodes, wide_bvh.getNodes().data(), wide_bvh.getNodes().size());
+        writer.section(kCacheWideBlocks, wide_bvh.getBlocks().data(), wide_bvh.getBlocks().size());
+#endif
+
+        // 材质名按下标顺序还原 mtlname_to_id
+        std::vector<std::string> names(materials.size());
+        for (const auto& kv : mtlname_to_id) {
+            if (kv.second >= 0 && kv.second < static_cast<int>(names.size())) names[kv.second] = kv.first;
+        }
+        std::string strings;
+        std::vector<MeshCacheMaterial> records(materials.size());
+        for (size_t i = 0; i < materials.size(); ++i) {
+            const Material* mat = materials[i];
+            MeshCacheMaterial& r = records[i];
+            const Vector3f* colors[3] = {&mat->m_color, &mat->m_emission, &mat->m_specular};
+            float* dst[3] = {r.color, r.emission, r.specular};
+            for (int c = 0; c < 3; ++c) {
+                dst[c][0] = colors[c]->x;
+                dst[c][1] = colors[c]->y;
+                dst[c][2] = colors[c]->z;
             }
-            return;
+            r.phong_exp = mat->m_phong_exp;
+            r.type = static_cast<uint32_t>(mat->m_type);
+            r.two_sided = mat->m_two_sided ? 1u : 0u;
+            r.name_offset = static_cast<uint32_t>(strings.size());
+            r.name_length = static_cast<uint32_t>(names[i].size());
+            strings += names[i];
+            // 记录 MTL 里的贴图路径，不管这次是否解码成功：贴图文件不在源文件哈希里，
+            // 加载缓存时照样重新解码，失败才退回 m_color，与解析 OBJ 时一致
+            const std::string& texture = mat->tex_path;
+            r.texture_offset = static_cast<uint32_t>(strings.size());
+            r.texture_length = static_cast<uint32_t>(texture.size());
+            strings += texture;
         }
+        writer.section(kCacheMaterials, records.data(), records.size());
+        writer.section(kCacheStrings, strings.data(), strings.size());
+        return writer.write(path);
+    }
 
-        if (!reader.Warning().empty()) {
-            std::cerr << "TinyObjReader: " << reader.Warning() << std::endl;
+    // 二叉 BVH：孩子下标比父节点大（深度优先存放，也保证没有环）且不越界，深度放得进遍历栈，
+    // 叶子的图元区间落在 prims 内，图元下标小于面数
+    static bool validCacheBvh(const Buffer<BVHNode>& nodes, const Buffer<uint32_t>& prims, size_t faces) {
+        for (uint32_t p : prims) {
+            if (p >= faces) return false;
         }
+        std::vector<uint8_t> depth(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            const BVHNode& node = nodes[i];
+            if (node.isLeaf()) {
+                if (uint64_t(node.offset) + node.count > prims.size()) return false;
+                continue;
+            }
+            // BVH::occluded / occludedPacket 每访问一个内部节点压入两个孩子，
+            // 沿左边一路下去时深度为 d 的节点会让栈里有 d + 2 个元素
+            if (depth[i] + 2 > BVH::kStackSize) return false;
+            if (i + 1 >= nodes.size() || node.offset <= i + 1 || node.offset >= nodes.size()) return false;
+            depth[i + 1] = std::max<uint8_t>(depth[i + 1], depth[i] + 1);
+            depth[node.offset] = std::max<uint8_t>(depth[node.offset], depth[i] + 1);
+        }
+        return true;
+    }
 
-        const tinyobj::attrib_t& attrib = reader.GetAttrib();
-        const std::vector<tinyobj::shape_t>& shapes = reader.GetShapes();
-        const std::vector<tinyobj::material_t>& obj_materials = reader.GetMaterials();
+#if PT_BVH_WIDTH > 2
+    // 宽 BVH：同样要求内部孩子在父节点之后、深度不超过 64，叶子的块区间不越界，
+    // 块里的图元是面下标或 kInvalid；空槽的 child 为 kInvalid、count 为 0
+    static bool validCacheWideBvh(const Buffer<WideBVH<PT_BVH_WIDTH>::Node>& nodes,
+                                  const Buffer<WideBVH<PT_BVH_WIDTH>::TriangleBlock>& blocks, size_t faces) {
+        using Wide = WideBVH<PT_BVH_WIDTH>;
+        if (nodes.empty()) return false;
+        for (const Wide::TriangleBlock& blk : blocks) {
+            for (uint32_t p : blk.prim) {
+                if (p != Wide::kInvalid && p >= faces) return false;
+            }
+        }
+        std::vector<uint8_t> depth(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (depth[i] > Wide::kStackSize / Wide::kWidth) return false;
+            for (int k = 0; k < Wide::kWidth; ++k) {
+                const uint32_t child = nodes[i].child[k];
+                const uint32_t count = nodes[i].count[k];
+                if (child == Wide::kInvalid) {
+                    if (count != 0) return false;
+                } else if (count > 0) {
+                    if (uint64_t(child) + count > blocks.size()) return false;
+                } else {
+                    if (child <= i || child >= nodes.size()) return false;
+                    depth[child] = std::max<uint8_t>(depth[child], depth[i] + 1);
+                }
+            }
+        }
+        return true;
+    }
+#endif
+
+    // 所有段都检查通过后才替换成员，中途失败时对象保持为空，由调用者退回解析 OBJ
+    bool loadCache(const std::string& path, uint64_t source_hash) {
+        uint32_t layout[4];
+        cacheLayout(layout);
+        MeshCacheReader reader;
+        if (!reader.open(path, source_hash, PT_BVH_WIDTH, static_cast<uint32_t>(options_.bvh_quality), layout)) {
+            return false;
+        }
+
+        bool ok = true;
+        Buffer<Vector3f> c_positions = reader.view<Vector3f>(kCachePositions, ok);
+        Buffer<Vector2f> c_texcoords = reader.view<Vector2f>(kCacheTexcoords, ok);
+        Buffer<uint32_t> c_indices = reader.view<uint32_t>(kCacheIndices, ok);
+        Buffer<int32_t> c_uv_indices = reader.view<int32_t>(kCacheUvIndices, ok);
+        Buffer<int32_t> c_material_ids = reader.view<int32_t>(kCacheMaterialIds, ok);
+        Buffer<uint32_t> c_emissive = reader.view<uint32_t>(kCacheEmissiveFaces, ok);
+        Buffer<BVHNode> c_bvh_nodes = reader.view<BVHNode>(kCacheBvhNodes, ok);
+        Buffer<uint32_t> c_bvh_prims = reader.view<uint32_t>(kCacheBvhPrims, ok);
+#if PT_BVH_WIDTH > 2
+        using Wide = WideBVH<PT_BVH_WIDTH>;
+        Buffer<Wide::Node> c_wide_nodes = reader.view<Wide::Node>(kCacheWideNodes, ok);
+        Buffer<Wide::TriangleBlock> c_wide_blocks = reader.view<Wide::TriangleBlock>(kCacheWideBlocks, ok);
+#endif
+        Buffer<MeshCacheMaterial> c_materials = reader.view<MeshCacheMaterial>(kCacheMaterials, ok);
+        Buffer<char> c_strings = reader.view<char>(kCacheStrings, ok);
+        if (!ok) return false;
+
+        // 只做廉价的一致性检查，防止截断或手改过的文件让求交、遍历越界；不一致就当作过期的缓存
+        const size_t faces = c_material_ids.size();
+        if (faces == 0 || c_indices.size() != 3 * faces || c_uv_indices.size() != 3 * faces ||
+            c_bvh_prims.size() != faces || c_bvh_nodes.empty()) {
+            return false;
+        }
+        for (uint32_t i : c_indices) {
+            if (i >= c_positions.size()) return false;
+        }
+        // 每面的 UV 下标要么三个都是 -1，要么三个都合法（finalizeHit 只看第一个）
+        for (size_t f = 0; f < faces; ++f) {
+            const int32_t* uv = &c_uv_indices[3 * f];
+            const bool none = uv[0] == -1 && uv[1] == -1 && uv[2] == -1;
+            bool all = true;
+            for (int k = 0; k < 3; ++k) {
+                if (uv[k] < 0 || uv[k] >= static_cast<int64_t>(c_texcoords.size())) all = false;
+            }
+            if (!none && !all) return false;
+        }
+        for (int32_t id : c_material_ids) {
+            if (id < -1 || id >= static_cast<int64_t>(c_materials.size())) return false;
+        }
+        for (uint32_t f : c_emissive) {
+            if (f >= faces) return false;
+        }
+        if (!validCacheBvh(c_bvh_nodes, c_bvh_prims, faces)) return false;
+#if PT_BVH_WIDTH > 2
+        if (!validCacheWideBvh(c_wide_nodes, c_wide_blocks, faces)) return false;
+#endif
+        for (const MeshCacheMaterial& r : c_materials) {
+            if (uint64_t(r.name_offset) + r.name_length > c_strings.size() ||
+                uint64_t(r.texture_offset) + r.texture_length > c_strings.size()) {
+                return false;
+            }
+        }
+
+        positions = std::move(c_positions);
+        texcoords = std::move(c_texcoords);
+        indices = std::move(c_indices);
+        uv_indices = std::move(c_uv_indices);
+        material_ids = std::move(c_material_ids);
+        emissive_faces = std::move(c_emissive);
+        total_emissive_area = reader.getHeader().total_emissive_area;
+        bvh.assign(std::move(c_bvh_nodes), std::move(c_bvh_prims));
+#if PT_BVH_WIDTH > 2
+        wide_bvh.assign(std::move(c_wide_nodes), std::move(c_wide_blocks));
+#endif
+
+        materials.reserve(c_materials.size());
+        for (size_t i = 0; i < c_materials.size(); ++i) {
+            const MeshCacheMaterial& r = c_materials[i];
+            Material* mat = new Material(Vector3f(r.color[0], r.color[1], r.color[2]),
+                                         Vector3f(r.emission[0], r.emission[1], r.emission[2]),
+                                         static_cast<MaterialType>(r.type));
+            mat->m_specular = Vector3f(r.specular[0], r.specular[1], r.specular[2]);
+            mat->m_phong_exp = r.phong_exp;
+            mat->m_two_sided = (r.two_sided != 0);
+            if (r.texture_length > 0) {
+                mat->loadTextureAsync(std::string(c_strings.data() + r.texture_offset, r.texture_length),
+                                      options_.pool);
+            }
+            mtlname_to_id[std::string(c_strings.data() + r.name_offset, r.name_length)] = static_cast<int>(i);
+            materials.push_back(mat);
+        }
+
+        cache_file = reader.release();
+        return true;
+    }
+
+    void loadObj(const std::string& obj_path) {
+        std::string basedir = objBaseDir(obj_path);
+
+        // 顶点、下标、材质 id 由解析器直接写进最终数组，下面只需 move 进 Buffer
+        ObjMesh obj;
+        std::string error;
+        // 贴图在 MTL 读完后就交给线程池解码，与后面的解析、建 BVH 并行；
+        // 下面的材质循环按同一路径拿到同一个 Handle，Scene::commit 时才等待
+        auto prefetch = [&](const std::vector<ObjMaterial>& mtls) {
+            for (const ObjMaterial& m : mtls) {
+                if (!m.diffuse_texname.empty()) {
+                    TextureManager::instance().loadAsync(basedir + "/" + m.diffuse_texname, options_.pool);
+                }
+            }
+        };
+        if (!ObjLoader::load(obj_path, obj, options_.pool, error, prefetch)) {
+            std::cerr << "ObjLoader: " << error << std::endl;
+            return;
+        }
+        const std::vector<ObjMaterial>& obj_materials = obj.materials;
 
         // materials.reserve(obj_materials.size());
         // for (size_t i = 0; i < obj_materials.size(); ++i) {
@@ -192,7 +645,7 @@ private:
             if (mat_type == MaterialType::PHONG) {
                 mat->m_specular = Vector3f(m.specular[0], m.specular[1], m.specular[2]);
                 // Ns 直接用作指数会很大，适当压缩一下
-                float Ns = m.shininess; // tinyobj 里 Ns 在 shininess 字段
+                float Ns = m.shininess; // Ns 在 shininess 字段
                 mat->m_phong_exp = std::max(1.0f, Ns * 0.25f);
             }
 
@@ -222,7 +675,7 @@ private:
 
             if (!m.diffuse_texname.empty()) {
                 std::string tex_path = basedir + "/" + m.diffuse_texname;
-                mat->loadTexture(tex_path);
+                mat->loadTextureAsync(tex_path, options_.pool);
             }
 
             mtlname_to_id[m.name] = static_cast<int>(i);
@@ -230,71 +683,25 @@ private:
         }
 
 
-        // 2) 构建三角形，并绑定正确的材质
-        for (size_t s = 0; s < shapes.size(); ++s) {
-            size_t index_offset = 0;
-            const auto& mesh = shapes[s].mesh;
-
-            for (size_t f = 0; f < mesh.num_face_vertices.size(); ++f) {
-                size_t fv = static_cast<size_t>(mesh.num_face_vertices[f]);
-                if (fv != 3) {
-                    index_offset += fv;
-                    continue;
-                }
-
-                Vector3f v[3];
-                Vector2f uv[3];
-                for (size_t k = 0; k < 3; ++k) {
-                    tinyobj::index_t idx = mesh.indices[index_offset + k];
-                    float vx = attrib.vertices[3 * idx.vertex_index + 0];
-                    float vy = attrib.vertices[3 * idx.vertex_index + 1];
-                    float vz = attrib.vertices[3 * idx.vertex_index + 2];
-                    v[k] = Vector3f(vx, vy, vz);
-
-                    if (idx.texcoord_index >= 0) {
-                        float u = attrib.texcoords[2 * idx.texcoord_index + 0];
-                        float w = attrib.texcoords[2 * idx.texcoord_index + 1];
-                        uv[k] = Vector2f(u, w);
-                    } else {
-                        uv[k] = Vector2f(0.0f, 0.0f);
-                    }
-                }
-
-                int mat_id = -1;
-                if (!mesh.material_ids.empty()) {
-                    mat_id = mesh.material_ids[f];
-                }
-
-                Material* face_mat = nullptr;
-                if (mat_id >= 0 && mat_id < (int)materials.size()) {
-                    face_mat = materials[mat_id];
-                }
-
-                // Triangle* tri = new Triangle(v[0], v[1], v[2], face_mat);
-                Triangle* tri;
-                bool has_uv = (mesh.indices[index_offset + 0].texcoord_index >= 0 &&
-                               mesh.indices[index_offset + 1].texcoord_index >= 0 &&
-                               mesh.indices[index_offset + 2].texcoord_index >= 0);
-                if (has_uv) {
-                    tri = new Triangle(v[0], v[1], v[2], uv[0], uv[1], uv[2], face_mat);
-                } else {
-                    tri = new Triangle(v[0], v[1], v[2], face_mat);
-                }
-                triangles.push_back(tri);
-
-                if (face_mat && face_mat->isEmissive()) {
-                    emissive_tris.push_back(tri);
-                    total_emissive_area += tri->area();
-                }
-
-                index_offset += fv;
+        // 2) 顶点、UV、面片下标都已是最终格式，保留 OBJ 里的共享关系
+        positions = std::move(obj.positions);
+        texcoords = std::move(obj.texcoords);
+        indices = std::move(obj.indices);
+        uv_indices = std::move(obj.uv_indices);
+        material_ids = std::move(obj.material_ids);
+
+        std::vector<uint32_t> out_emissive;
+        for (uint32_t face = 0; face < faceCount(); ++face) {
+            Material* face_mat = getFaceMaterial(face);
+            if (face_mat && face_mat->isEmissive()) {
+                Vector3f v0, v1, v2;
+                getFaceVertices(face, v0, v1, v2);
+                out_emissive.push_back(face);
+                total_emissive_area += 0.5f * cross(v1 - v0, v2 - v0).length();
             }
         }
+        emissive_faces = std::move(out_emissive);
 
-        std::cout << "Loaded OBJ: " << obj_path
-                  << " with " << triangles.size() << " triangles." << std::endl;
-        printAABB();
-        std::cout << "Emissive tris: " << emissive_tris.size()
-                  << ", total emissive area: " << total_emissive_area << std::endl;
+        buildBVH();
     }
 };
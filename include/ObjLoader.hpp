@@ -0,0 +1,481 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "global.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+// MTL 里用到的材质参数，缺省值与 tinyobj 相同
+struct ObjMaterial {
+    std::string name;
+    float diffuse[3] = {0.0f, 0.0f, 0.0f};
+    float specular[3] = {0.0f, 0.0f, 0.0f};
+    float shininess = 1.0f;
+    std::string diffuse_texname;
+};
+
+// 解析结果就是 MeshTriangle 的最终数组，不再经过中间的 shape 结构
+struct ObjMesh {
+    std::vector<Vector3f> positions;
+    std::vector<Vector2f> texcoords;
+    std::vector<uint32_t> indices;     // 每面 3 个
+    std::vector<int32_t>  uv_indices;  // 每面 3 个；面上任一顶点没有 vt 时三个都是 -1
+    std::vector<int32_t>  material_ids; // 每面 1 个，-1 表示无材质
+    std::vector<ObjMaterial> materials;
+};
+
+// OBJ 读取：mmap 整个文件，按行边界切块，两遍并行解析
+//   第一遍：各块分别数出 v / vt / 三角形的个数、行数，记下 mtllib 和最后一个 usemtl
+//   之后按块的顺序求前缀和，得到每块写入的起点、块开头的当前材质；读 MTL
+//   第二遍：各块解析数字，直接写进最终数组里属于自己的那一段
+//   四边形要按顶点位置选对角线，引用了前面块里顶点的留到第二遍结束后再切
+// 结果与切块方式、线程数无关。只处理 v / vt / f / usemtl / mtllib，法线、组、平滑组等忽略；
+// 负下标相对于该行之前的顶点数；四边形按较短的对角线切开（与 tinyobj 相同），更多边的面按扇形切开
+class ObjLoader {
+public:
+    using MaterialsCallback = std::function<void(const std::vector<ObjMaterial>&)>;
+
+    // pool 为空时单线程解析；失败时返回 false，error 里是原因
+    // on_materials 在 MTL 读完、第二遍解析开始之前调用，可以趁早提交贴图解码
+    static bool load(const std::string& path, ObjMesh& mesh, ThreadPool* pool, std::string& error,
+                     const MaterialsCallback& on_materials = MaterialsCallback()) {
+        MappedFile file;
+        if (!file.open(path)) {
+            error = "cannot open " + path;
+            return false;
+        }
+        const char* text = reinterpret_cast<const char*>(file.data());
+        const size_t size = file.size();
+
+        std::vector<Chunk> chunks = splitChunks(text, size, pool);
+        forEachChunk(pool, chunks.size(), [&](size_t c) { countChunk(text, chunks[c]); });
+
+        // 块的顺序就是文件顺序：前缀和、mtllib、跨块延续的 usemtl 都按顺序处理
+        const std::string basedir = baseDir(path);
+        std::unordered_map<std::string, int> material_map;
+        for (const Chunk& chunk : chunks) {
+            for (const std::string& lib : chunk.mtllibs) {
+                loadMtl(basedir + "/" + lib, mesh.materials, material_map);
+            }
+        }
+        if (on_materials) on_materials(mesh.materials);
+        uint32_t v = 0, vt = 0, tris = 0;
+        uint64_t lines = 0;
+        int32_t material = -1;
+        for (Chunk& chunk : chunks) {
+            chunk.v_base = v;
+            chunk.vt_base = vt;
+            chunk.tri_base = tris;
+            chunk.line_base = lines;
+            chunk.start_material = material;
+            v += chunk.v_count;
+            vt += chunk.vt_count;
+            tris += chunk.tri_count;
+            lines += chunk.lines;
+            if (chunk.has_usemtl) material = lookupMaterial(material_map, chunk.last_usemtl);
+        }
+
+        mesh.positions.assign(v, Vector3f());
+        mesh.texcoords.assign(vt, Vector2f());
+        mesh.indices.assign(3 * static_cast<size_t>(tris), 0);
+        mesh.uv_indices.assign(3 * static_cast<size_t>(tris), -1);
+        mesh.material_ids.assign(tris, -1);
+
+        forEachChunk(pool, chunks.size(), [&](size_t c) {
+            parseChunk(text, chunks[c], material_map, mesh);
+        });
+        for (const Chunk& chunk : chunks) {
+            if (!chunk.error.empty()) {
+                error = path + ":" + chunk.error;
+                return false;
+            }
+        }
+        // 引用了前面块里顶点的四边形，要等所有顶点都写完才能选对角线
+        forEachChunk(pool, chunks.size(), [&](size_t c) {
+            for (const PendingQuad& q : chunks[c].pending_quads) {
+                uint32_t tri = q.tri;
+                emitQuad(q.f, q.material, mesh, tri);
+            }
+        });
+        return true;
+    }
+
+private:
+    // 每块至少这么大，避免小文件切得太碎
+    static constexpr size_t kMinChunkBytes = 256 * 1024;
+
+    struct FaceVertex {
+        uint32_t v;
+        int32_t vt;  // -1 表示没有
+    };
+
+    struct PendingQuad {
+        uint32_t tri;
+        int32_t material;
+        FaceVertex f[4];
+    };
+
+    struct Chunk {
+        size_t begin = 0, end = 0;
+        // 第一遍的统计
+        uint32_t v_count = 0, vt_count = 0, tri_count = 0;
+        uint64_t lines = 0;
+        bool has_usemtl = false;
+        std::string last_usemtl;
+        std::vector<std::string> mtllibs;
+        // 第二遍的起点
+        uint32_t v_base = 0, vt_base = 0, tri_base = 0;
+        uint64_t line_base = 0;
+        int32_t start_material = -1;
+        std::vector<PendingQuad> pending_quads;
+        std::string error;
+    };
+
+    static std::string baseDir(const std::string& path) {
+        auto slash_pos = path.find_last_of("/\\");
+        return (slash_pos == std::string::npos) ? std::string(".") : path.substr(0, slash_pos);
+    }
+
+    template <typename F>
+    static void forEachChunk(ThreadPool* pool, size_t count, F&& fn) {
+        if (!pool || count <= 1) {
+            for (size_t c = 0; c < count; ++c) fn(c);
+            return;
+        }
+        pool->parallelFor(static_cast<int>(count), 1, [&](int c, int) { fn(static_cast<size_t>(c)); });
+    }
+
+    // 每个线程若干块，块的边界挪到下一个换行之后
+    static std::vector<Chunk> splitChunks(const char* text, size_t size, ThreadPool* pool) {
+        size_t want = 1;
+        if (pool && pool->size() > 1) {
+            want = std::max<size_t>(1, std::min<size_t>(size / kMinChunkBytes, 4 * pool->size()));
+        }
+        std::vector<Chunk> chunks;
+        size_t begin = 0;
+        for (size_t c = 0; c < want && begin < size; ++c) {
+            size_t end = (c + 1 == want) ? size : std::max(begin, size / want * (c + 1));
+            if (end < size) {
+                const void* nl = std::memchr(text + end, '\n', size - end);
+                end = nl ? static_cast<size_t>(static_cast<const char*>(nl) - text) + 1 : size;
+            }
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = end;
+            chunks.push_back(chunk);
+            begin = end;
+        }
+        return chunks;
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    static const char* skipSpace(const char* p, const char* end) {
+        while (p < end && isSpace(*p)) ++p;
+        return p;
+    }
+
+    static const char* lineEnd(const char* p, const char* end) {
+        const void* nl = std::memchr(p, '\n', static_cast<size_t>(end - p));
+        return nl ? static_cast<const char*>(nl) : end;
+    }
+
+    // 行首关键字是否为 key，且后面跟着空白
+    static bool isKeyword(const char* p, const char* end, const char* key, size_t len) {
+        return static_cast<size_t>(end - p) > len && std::memcmp(p, key, len) == 0 && isSpace(p[len]);
+    }
+
+    // 行内剩余部分去掉首尾空白，作为名字（材质名、文件名）
+    static std::string restOfLine(const char* p, const char* end) {
+        p = skipSpace(p, end);
+        while (end > p && isSpace(end[-1])) --end;
+        return std::string(p, end);
+    }
+
+    static int countTokens(const char* p, const char* end) {
+        int n = 0;
+        while (true) {
+            p = skipSpace(p, end);
+            if (p >= end) return n;
+            ++n;
+            while (p < end && !isSpace(*p)) ++p;
+        }
+    }
+
+    static void countChunk(const char* text, Chunk& chunk) {
+        const char* p = text + chunk.begin;
+        const char* end = text + chunk.end;
+        while (p < end) {
+            const char* eol = lineEnd(p, end);
+            const char* s = skipSpace(p, eol);
+            ++chunk.lines;
+            if (isKeyword(s, eol, "v", 1)) {
+                ++chunk.v_count;
+            } else if (isKeyword(s, eol, "vt", 2)) {
+                ++chunk.vt_count;
+            } else if (isKeyword(s, eol, "f", 1)) {
+                int n = countTokens(s + 1, eol);
+                if (n >= 3) chunk.tri_count += static_cast<uint32_t>(n - 2);
+            } else if (isKeyword(s, eol, "usemtl", 6)) {
+                chunk.has_usemtl = true;
+                chunk.last_usemtl = restOfLine(s + 6, eol);
+            } else if (isKeyword(s, eol, "mtllib", 6)) {
+                // 一行可以列多个 mtl 文件
+                const char* q = s + 6;
+                while (true) {
+                    q = skipSpace(q, eol);
+                    if (q >= eol) break;
+                    const char* e = q;
+                    while (e < eol && !isSpace(*e)) ++e;
+                    chunk.mtllibs.emplace_back(q, e);
+                    q = e;
+                }
+            }
+            p = eol + 1;
+        }
+    }
+
+    static int32_t lookupMaterial(const std::unordered_map<std::string, int>& material_map,
+                                  const std::string& name) {
+        auto it = material_map.find(name);
+        return (it == material_map.end()) ? -1 : it->second;
+    }
+
+    // 十进制浮点数：有效数字不超过 19 位且指数不大时，尾数和 10 的幂都能用 double 精确表示，
+    // 一次乘除就得到正确舍入的 double；其余情况交给 strtod
+    static const char* parseFloat(const char* p, const char* end, float& out) {
+        static const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        p = skipSpace(p, end);
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+        uint64_t mantissa = 0;
+        int digits = 0, exp10 = 0;
+        bool any = false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                if (mantissa) ++digits;
+            } else {
+                ++exp10;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p, any = true) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    if (mantissa) ++digits;
+                    --exp10;
+                }
+            }
+        }
+        if (any && p < end && (*p == 'e' || *p == 'E')) {
+            const char* q = p + 1;
+            bool exp_negative = false;
+            if (q < end && (*q == '-' || *q == '+')) exp_negative = (*q++ == '-');
+            if (q < end && *q >= '0' && *q <= '9') {
+                int e = 0;
+                for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+                    if (e < 10000) e = e * 10 + (*q - '0');
+                }
+                exp10 += exp_negative ? -e : e;
+                p = q;
+            }
+        }
+        const bool delimited = (p >= end || isSpace(*p) || *p == '/');
+        if (any && delimited && mantissa < (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+            double d = static_cast<double>(mantissa);
+            d = (exp10 < 0) ? d / kPow10[-exp10] : d * kPow10[exp10];
+            out = static_cast<float>(negative ? -d : d);
+            return p;
+        }
+
+        // 慢路径：长尾数、大指数、inf / nan 等
+        const char* token_end = start;
+        while (token_end < end && !isSpace(*token_end)) ++token_end;
+        char buf[128];
+        size_t len = std::min<size_t>(static_cast<size_t>(token_end - start), sizeof(buf) - 1);
+        std::memcpy(buf, start, len);
+        buf[len] = '\0';
+        out = static_cast<float>(std::strtod(buf, nullptr));
+        return token_end;
+    }
+
+    // 下标：正数从 1 开始，负数相对于当前已有的个数；0 或越界返回 false
+    static const char* parseIndex(const char* p, const char* end, uint32_t count, int64_t& index, bool& ok) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+        int64_t value = 0;
+        bool any = false;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p, any = true) {
+            if (value < (int64_t(1) << 40)) value = value * 10 + (*p - '0');
+        }
+        if (!any || value == 0) {
+            ok = false;
+            return p;
+        }
+        index = negative ? static_cast<int64_t>(count) - value : value - 1;
+        ok = index >= 0 && index < static_cast<int64_t>(count);
+        return p;
+    }
+
+    static void parseChunk(const char* text, Chunk& chunk,
+                           const std::unordered_map<std::string, int>& material_map, ObjMesh& mesh) {
+        const char* p = text + chunk.begin;
+        const char* end = text + chunk.end;
+        uint32_t v = chunk.v_base, vt = chunk.vt_base, tri = chunk.tri_base;
+        uint64_t line = chunk.line_base;
+        int32_t material = chunk.start_material;
+        std::vector<FaceVertex> face;
+
+        while (p < end) {
+            const char* eol = lineEnd(p, end);
+            const char* s = skipSpace(p, eol);
+            ++line;
+            if (isKeyword(s, eol, "v", 1)) {
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                const char* q = parseFloat(s + 1, eol, x);
+                q = parseFloat(q, eol, y);
+                parseFloat(q, eol, z);
+                mesh.positions[v++] = Vector3f(x, y, z);
+            } else if (isKeyword(s, eol, "vt", 2)) {
+                float x = 0.0f, y = 0.0f;
+                const char* q = parseFloat(s + 2, eol, x);
+                parseFloat(q, eol, y);
+                mesh.texcoords[vt++] = Vector2f(x, y);
+            } else if (isKeyword(s, eol, "f", 1)) {
+                face.clear();
+                const char* q = s + 1;
+                while (true) {
+                    q = skipSpace(q, eol);
+                    if (q >= eol) break;
+                    FaceVertex fv{0, -1};
+                    int64_t index = 0;
+                    bool ok = true;
+                    q = parseIndex(q, eol, v, index, ok);
+                    if (!ok) {
+                        chunk.error = std::to_string(line) + ": vertex index out of range";
+                        return;
+                    }
+                    fv.v = static_cast<uint32_t>(index);
+                    // v/vt、v/vt/vn、v//vn；vt 越界按没有 UV 处理，vn 不用
+                    if (q < eol && *q == '/') {
+                        ++q;
+                        if (q < eol && *q != '/') {
+                            q = parseIndex(q, eol, vt, index, ok);
+                            if (ok) fv.vt = static_cast<int32_t>(index);
+                        }
+                    }
+                    while (q < eol && !isSpace(*q)) ++q;
+                    face.push_back(fv);
+                }
+                if (face.size() == 4 && !localQuad(face, chunk.v_base)) {
+                    chunk.pending_quads.push_back({tri, material, {face[0], face[1], face[2], face[3]}});
+                    tri += 2;
+                } else {
+                    emitFace(face, material, mesh, tri);
+                }
+            } else if (isKeyword(s, eol, "usemtl", 6)) {
+                material = lookupMaterial(material_map, restOfLine(s + 6, eol));
+            }
+            p = eol + 1;
+        }
+    }
+
+    static void emitTriangle(const FaceVertex& a, const FaceVertex& b, const FaceVertex& c,
+                             int32_t material, ObjMesh& mesh, uint32_t& tri) {
+        const size_t base = 3 * static_cast<size_t>(tri);
+        const bool has_uv = a.vt >= 0 && b.vt >= 0 && c.vt >= 0;
+        mesh.indices[base + 0] = a.v;
+        mesh.indices[base + 1] = b.v;
+        mesh.indices[base + 2] = c.v;
+        mesh.uv_indices[base + 0] = has_uv ? a.vt : -1;
+        mesh.uv_indices[base + 1] = has_uv ? b.vt : -1;
+        mesh.uv_indices[base + 2] = has_uv ? c.vt : -1;
+        mesh.material_ids[tri] = material;
+        ++tri;
+    }
+
+    // 四个顶点都在本块里（已经由本线程写好）
+    static bool localQuad(const std::vector<FaceVertex>& f, uint32_t v_base) {
+        return f[0].v >= v_base && f[1].v >= v_base && f[2].v >= v_base && f[3].v >= v_base;
+    }
+
+    // 较短的对角线切开
+    static void emitQuad(const FaceVertex* f, int32_t material, ObjMesh& mesh, uint32_t& tri) {
+        const Vector3f& p0 = mesh.positions[f[0].v];
+        const Vector3f& p1 = mesh.positions[f[1].v];
+        const Vector3f& p2 = mesh.positions[f[2].v];
+        const Vector3f& p3 = mesh.positions[f[3].v];
+        if ((p2 - p0).length2() < (p3 - p1).length2()) {
+            emitTriangle(f[0], f[1], f[2], material, mesh, tri);
+            emitTriangle(f[0], f[2], f[3], material, mesh, tri);
+        } else {
+            emitTriangle(f[0], f[1], f[3], material, mesh, tri);
+            emitTriangle(f[1], f[2], f[3], material, mesh, tri);
+        }
+    }
+
+    static void emitFace(const std::vector<FaceVertex>& f, int32_t material, ObjMesh& mesh, uint32_t& tri) {
+        if (f.size() < 3) return;
+        if (f.size() == 4) {
+            emitQuad(f.data(), material, mesh, tri);
+            return;
+        }
+        for (size_t k = 1; k + 1 < f.size(); ++k) {
+            emitTriangle(f[0], f[k], f[k + 1], material, mesh, tri);
+        }
+    }
+
+    // MTL：只读 newmtl / Kd / Ks / Ns / map_Kd；同名材质以先出现的为准
+    static void loadMtl(const std::string& path, std::vector<ObjMaterial>& materials,
+                        std::unordered_map<std::string, int>& material_map) {
+        MappedFile file;
+        if (!file.open(path)) return;
+        const char* p = reinterpret_cast<const char*>(file.data());
+        const char* end = p + file.size();
+        ObjMaterial* cur = nullptr;
+        ObjMaterial scratch;
+        while (p < end) {
+            const char* eol = lineEnd(p, end);
+            const char* s = skipSpace(p, eol);
+            if (isKeyword(s, eol, "newmtl", 6)) {
+                std::string name = restOfLine(s + 6, eol);
+                if (material_map.count(name)) {
+                    cur = &scratch;
+                    *cur = ObjMaterial();
+                } else {
+                    material_map[name] = static_cast<int>(materials.size());
+                    materials.emplace_back();
+                    cur = &materials.back();
+                }
+                cur->name = name;
+            } else if (cur && isKeyword(s, eol, "Kd", 2)) {
+                const char* q = parseFloat(s + 2, eol, cur->diffuse[0]);
+                q = parseFloat(q, eol, cur->diffuse[1]);
+                parseFloat(q, eol, cur->diffuse[2]);
+            } else if (cur && isKeyword(s, eol, "Ks", 2)) {
+                const char* q = parseFloat(s + 2, eol, cur->specular[0]);
+                q = parseFloat(q, eol, cur->specular[1]);
+                parseFloat(q, eol, cur->specular[2]);
+            } else if (cur && isKeyword(s, eol, "Ns", 2)) {
+                parseFloat(s + 2, eol, cur->shininess);
+            } else if (cur && isKeyword(s, eol, "map_Kd", 6)) {
+                // 前面可能带 -bm 之类的选项，文件名取最后一项
+                std::string rest = restOfLine(s + 6, eol);
+                auto space = rest.find_last_of(" \t");
+                cur->diffuse_texname = (space == std::string::npos) ? rest : rest.substr(space + 1);
+            }
+            p = eol + 1;
+        }
+    }
+};
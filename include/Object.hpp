@@ -2,6 +2,7 @@
 
 #include "global.hpp"
 #include "HitRecord.hpp"
+#include "RayPacket.hpp"
 
 // 所有可被光线求交的几何体的抽象基类
 class Object {
@@ -13,6 +14,49 @@ public:
     // hit_t_min 可用于限制最小 t（防止自交），我们暂时先不传，在 Scene 里统一处理
     virtual bool intersect(const Ray& ray, HitRecord& rec) const = 0;
 
+    // 遮挡查询（阴影射线用）：只要在 (0, t_max) 内有任意交点就返回 true，不写 HitRecord
+    // 默认退化为最近交点查询，子类应当提供更快的 any-hit 实现
+    virtual bool occluded(const Ray& ray, float t_max) const {
+        HitRecord rec;
+        rec.t = t_max;
+        return intersect(ray, rec);
+    }
+
+    // 光线包求交：对 packet.active 中的每条射线，若在 (0, packet.t_max) 内有更近的交点，
+    // 就写进 recs[lane] 并把 packet.t_max[lane] 缩小到新的 t；返回本对象命中的射线掩码
+    // 默认逐条调用 intersect，子类可以一次遍历整包
+    virtual uint32_t intersectPacket(RayPacket& packet, HitRecord* recs) const {
+        uint32_t hits = 0;
+        for (uint32_t mask = packet.active; mask; mask &= mask - 1) {
+            int lane = simd::firstLane(mask);
+            recs[lane].t = packet.t_max[lane];
+            if (intersect(packet.ray(lane), recs[lane])) {
+                packet.t_max[lane] = recs[lane].t;
+                hits |= 1u << lane;
+            }
+        }
+        return hits;
+    }
+
+    // 光线包遮挡查询：返回 (0, t_max) 内被遮挡的射线掩码
+    virtual uint32_t occludedPacket(const RayPacket& packet) const {
+        uint32_t blocked = 0;
+        for (uint32_t mask = packet.active; mask; mask &= mask - 1) {
+            int lane = simd::firstLane(mask);
+            if (occluded(packet.ray(lane), packet.t_max[lane])) {
+                blocked |= 1u << lane;
+            }
+        }
+        return blocked;
+    }
+
+    // 世界空间的包围盒，Scene 用它建顶层 BVH
+    virtual AABB bounds() const = 0;
+
+    // Scene::commit 时调用：等待加载时提交的异步任务（贴图解码等）完成，之后才能开始渲染
+    // 材质是通过指针持有的，所以这里是 const
+    virtual void finishLoading() const {}
+
     // 某些对象可能需要知道自己是否是发光体，这里先留个接口（可选）
     virtual bool isEmissive() const { return false; }
 };
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 按类型统计追踪的射线数：相机射线、阴影射线、弹射（BSDF 采样）射线
+// 每个线程第一次计数时登记一块自己的计数器，只有本线程写，不需要原子加；
+// total() 在渲染结束（线程池 wait 之后）读各块的和
+enum RayType : int {
+    kRayCamera,
+    kRayShadow,
+    kRayBounce,
+    kRayTypeCount
+};
+
+inline const char* rayTypeName(RayType type) {
+    switch (type) {
+        case kRayCamera: return "camera";
+        case kRayShadow: return "shadow";
+        case kRayBounce: return "bounce";
+        default: return "unknown";
+    }
+}
+
+struct RayCounts {
+    uint64_t n[kRayTypeCount] = {};
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (uint64_t v : n) sum += v;
+        return sum;
+    }
+};
+
+// 每个线程一块计数器（Slot），线程第一次用到时登记；各块各占若干条完整的缓存行，互不干扰
+// 线程退出后块保留，计数仍然算在总数里。Slot 里的计数用 relaxed 原子变量，只有所属线程写
+template <typename Slot>
+class PerThreadSlots {
+public:
+    static Slot& local() {
+        thread_local Slot* slot = nullptr;
+        if (!slot) {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.slots.emplace_back(new Slot());
+            slot = r.slots.back().get();
+        }
+        return *slot;
+    }
+
+    // fn(Slot&) 依次作用于所有线程的块；求和、清零都只能在没有线程在计数时做
+    template <typename F>
+    static void forEach(F&& fn) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& slot : r.slots) fn(*slot);
+    }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Slot>> slots;
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+};
+
+// 只有所属线程写的计数器：读改写不需要原子加，但用原子变量让别的线程读到的值有定义
+inline void bumpCounter(std::atomic<uint64_t>& c, uint64_t count) {
+    c.store(c.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+class RayCounters {
+public:
+    static void add(RayType type, uint64_t count = 1) {
+        bumpCounter(Slots::local().n[type], count);
+    }
+
+    static RayCounts total() {
+        RayCounts out;
+        Slots::forEach([&](const Slot& slot) {
+            for (int t = 0; t < kRayTypeCount; ++t) out.n[t] += slot.n[t].load(std::memory_order_relaxed);
+        });
+        return out;
+    }
+
+    // 只能在没有线程在追踪射线时调用
+    static void reset() {
+        Slots::forEach([](Slot& slot) {
+            for (auto& c : slot.n) c.store(0, std::memory_order_relaxed);
+        });
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> n[kRayTypeCount];
+        Slot() {
+            for (auto& c : n) c.store(0, std::memory_order_relaxed);
+        }
+    };
+    using Slots = PerThreadSlots<Slot>;
+};
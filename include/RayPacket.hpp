@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include "global.hpp"
+#include "AABB.hpp"
+#include "SIMD.hpp"
+
+// 光线包：kPacketSize 条射线按 SoA 存放，一次 SIMD 运算处理整包
+// 用于相干的相机射线和同一批顶点的阴影射线；active 的第 i 位表示第 i 条射线是否参与
+struct alignas(32) RayPacket {
+    static constexpr int kSize = 8;
+    using vfloat = simd::vfloat<kSize>;
+
+    float org[3][kSize];
+    float dir[3][kSize];
+    float inv_dir[3][kSize];
+    float t_max[kSize];  // 每条射线当前的最远距离，求交时随最近交点缩小
+    uint32_t active = 0;
+
+    static constexpr uint32_t kAllLanes = (1u << kSize) - 1;
+
+    void set(int lane, const Ray& ray, float t) {
+        const float o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+        const float d[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+        for (int a = 0; a < 3; ++a) {
+            org[a][lane] = o[a];
+            dir[a][lane] = d[a];
+            inv_dir[a][lane] = 1.0f / d[a];
+        }
+        t_max[lane] = t;
+        active |= 1u << lane;
+    }
+
+    // 不参与的槽位也要填上合法的数，避免 SIMD 运算里出现未初始化的值
+    void clearLane(int lane) {
+        for (int a = 0; a < 3; ++a) {
+            org[a][lane] = 0.0f;
+            dir[a][lane] = 1.0f;
+            inv_dir[a][lane] = 1.0f;
+        }
+        t_max[lane] = 0.0f;
+        active &= ~(1u << lane);
+    }
+
+    Ray ray(int lane) const {
+        return Ray(Vector3f(org[0][lane], org[1][lane], org[2][lane]),
+                   Vector3f(dir[0][lane], dir[1][lane], dir[2][lane]));
+    }
+
+    // 活跃射线的方向是否都落在以第一条射线为轴、夹角余弦不小于 min_cos 的锥内
+    // 方向分散的包在 BVH 里很快就各走各的路，打包遍历反而比逐条慢
+    bool coherent(float min_cos) const {
+        if (!active) return true;
+        const int first = simd::firstLane(active);
+        vfloat dot = vfloat::load(dir[0]) * vfloat::broadcast(dir[0][first]) +
+                     vfloat::load(dir[1]) * vfloat::broadcast(dir[1][first]) +
+                     vfloat::load(dir[2]) * vfloat::broadcast(dir[2][first]);
+        return ((dot >= vfloat::broadcast(min_cos)).bits() & active) == active;
+    }
+
+    // 包内射线与一个 AABB 的 slab 测试，返回命中射线的掩码（未与 active 相与）
+    // lo / hi 的参数顺序保证 0 * inf 的 NaN 会让该轴被忽略，与标量的 intersectAABB 一致
+    uint32_t intersectBox(const AABB& b) const {
+        const float lo_p[3] = {b.min_p.x, b.min_p.y, b.min_p.z};
+        const float hi_p[3] = {b.max_p.x, b.max_p.y, b.max_p.z};
+        return intersectBox(lo_p, hi_p);
+    }
+
+    uint32_t intersectBox(const float lo_p[3], const float hi_p[3]) const {
+        vfloat t0 = vfloat::broadcast(0.0f);
+        vfloat t1 = vfloat::load(t_max);
+        for (int a = 0; a < 3; ++a) {
+            vfloat o = vfloat::load(org[a]);
+            vfloat inv = vfloat::load(inv_dir[a]);
+            vfloat lo = (vfloat::broadcast(lo_p[a]) - o) * inv;
+            vfloat hi = (vfloat::broadcast(hi_p[a]) - o) * inv;
+            t0 = simd::max(simd::min(hi, lo), t0);
+            t1 = simd::min(simd::max(hi, lo), t1);
+        }
+        return (t0 <= t1).bits();
+    }
+};
+
+// 光线包求交时每条射线的最近图元（其余属性由对象最后一次性补全）
+struct alignas(32) PacketHit {
+    uint32_t prim[RayPacket::kSize];
+    float u[RayPacket::kSize];
+    float v[RayPacket::kSize];
+};
@@ -0,0 +1,584 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "global.hpp"
+#include "camera.hpp"
+#include "Scene.hpp"
+#include "Sampler.hpp"
+#include "Stats.hpp"
+#include "ThreadPool.hpp"
+#include "Wavefront.hpp"
+
+enum class IntegratorType {
+    Path,      // 原来的路径追踪：光源采样 + BSDF 采样，只在直接命中时加自发光
+    MIS,       // 光源采样与 BSDF 采样用 power heuristic 合并
+    Wavefront  // 与 MIS 相同的估计量，按 wavefront 分阶段批量追踪（见 WavefrontIntegrator）
+};
+
+inline const char* integratorName(IntegratorType type) {
+    switch (type) {
+        case IntegratorType::MIS: return "MIS";
+        case IntegratorType::Wavefront: return "Wavefront";
+        default: return "Path";
+    }
+}
+
+struct RenderSettings {
+    int width = 256;
+    int height = 256;
+    int samples_per_pixel = 16;
+    int max_depth = 5;
+    // 从第几个路径顶点开始做俄罗斯轮盘（之前的顶点总是继续），见 Scene::russianRoulette
+    int rr_depth = 2;
+    int tile_size = 16;
+    // 每个 tile 的样本再切成几段并行；0 表示自动（tile 太少、喂不饱线程时才切）
+    int sample_splits = 0;
+    IntegratorType integrator = IntegratorType::Path;
+    SamplerType sampler = SamplerType::Sobol;
+    // 相机射线按 4x2 像素打包求交，第一个顶点的阴影射线也打包；之后各路径单独追踪
+    // wavefront 积分器不使用
+    bool packets = true;
+    uint32_t seed = 0;
+    bool show_progress = true;
+    // 逐像素记录耗时（cycleCount）和遍历步数（需要 PT_ENABLE_STATS），见 Renderer::pixelCosts
+    // 开启后每个像素单独计时：相机射线不再打包，wavefront 也退回逐条追踪（估计量相同，图像不变）
+    bool cost_map = false;
+    // 记录相机射线第一个交点的反照率 / 法线 / 深度，以及样本亮度的二阶矩，供降噪用，见 Renderer::pixelAovs
+    bool aov = false;
+
+    // 自适应采样：误差阈值（见 Renderer::relativeError），0 表示关闭
+    // 开启后 samples_per_pixel 变成平均预算（总样本数 = 像素数 * samples_per_pixel）
+    float adaptive_threshold = 0.0f;
+    int min_spp = 0;  // 第一轮每像素样本数，0 = 自动（samples_per_pixel / 4，至少 4）
+    int max_spp = 0;  // 单个像素的上限，0 = 自动（samples_per_pixel * 8）
+};
+
+// 一个像素所有样本的开销合计
+struct PixelCost {
+    uint64_t cycles = 0;
+    uint64_t steps = 0;  // BVH 节点访问 + 图元求交
+};
+
+// 一个像素的 AOV：渲染时是各样本之和，render() 结束后除以样本数变成均值
+// lum2 是样本亮度平方的均值，降噪器用它估计方差；没打中的样本各项都按 0 计
+struct PixelAov {
+    Vector3f albedo;
+    Vector3f normal;
+    float depth = 0.0f;
+    float lum2 = 0.0f;
+};
+
+// 基于 tile 的渲染调度
+// 画面切成 tile_size x tile_size 的块，每块（可能再按样本区间切分）是线程池里的一个任务；
+// 任务先在 tile 本地累加，结束时一次性写回，避免多个线程在 framebuffer 上伪共享
+class Renderer {
+public:
+    Renderer(const Scene& scene, const Camera& camera, const RenderSettings& settings)
+        : scene(scene), camera(camera), settings(settings) {}
+
+    // 渲染结果为每像素平均辐射度，行主序，j = 0 是最底下一行
+    void render(ThreadPool& pool, std::vector<Vector3f>& framebuffer) {
+        if (settings.adaptive_threshold > 0.0f) {
+            renderAdaptive(pool, framebuffer);
+            return;
+        }
+
+        const int width = settings.width;
+        const int height = settings.height;
+        const int spp = settings.samples_per_pixel;
+        const int tile = std::max(1, settings.tile_size);
+        const int total_pixels = width * height;
+
+        // 1) 生成 tile 列表
+        std::vector<WorkItem> tiles;
+        for (int y0 = 0; y0 < height; y0 += tile) {
+            for (int x0 = 0; x0 < width; x0 += tile) {
+                WorkItem w;
+                w.x0 = x0;
+                w.y0 = y0;
+                w.x1 = std::min(width, x0 + tile);
+                w.y1 = std::min(height, y0 + tile);
+                tiles.push_back(w);
+            }
+        }
+
+        // 2) 低分辨率时 tile 数太少喂不饱线程，就把样本切段
+        // 自动切分只看分辨率、不看线程数，这样分段求和的顺序（也就是浮点结果）与线程数无关
+        int splits = settings.sample_splits;
+        if (splits <= 0) {
+            int want = kMinWorkItems;
+            int n_tiles = static_cast<int>(tiles.size());
+            splits = (n_tiles >= want) ? 1 : (want + n_tiles - 1) / n_tiles;
+        }
+        splits = std::max(1, std::min(splits, spp));
+
+        std::vector<WorkItem> items;
+        items.reserve(tiles.size() * splits);
+        for (int k = 0; k < splits; ++k) {
+            for (WorkItem w : tiles) {
+                w.layer = k;
+                w.s0 = spp * k / splits;
+                w.s1 = spp * (k + 1) / splits;
+                items.push_back(w);
+            }
+        }
+
+        // 每个样本段写自己的一层，最后按固定顺序合并，结果与调度顺序无关；开销图也一样分层
+        std::vector<Vector3f> layers(static_cast<size_t>(splits) * total_pixels);
+        std::vector<PixelCost> cost_layers(settings.cost_map ? layers.size() : 0);
+        std::vector<PixelAov> aov_layers(settings.aov ? layers.size() : 0);
+        std::atomic<int> items_done{0};
+
+        TaskGroup group;
+        for (const WorkItem& w : items) {
+            pool.submit(group, [this, w, &layers, &cost_layers, &aov_layers, &items_done, total_pixels](int) {
+                const size_t offset = static_cast<size_t>(w.layer) * total_pixels;
+                renderItem(w, layers.data() + offset, cost_layers.empty() ? nullptr : cost_layers.data() + offset,
+                           aov_layers.empty() ? nullptr : aov_layers.data() + offset);
+                items_done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+
+        const int total_items = static_cast<int>(items.size());
+        while (!pool.waitFor(group, std::chrono::milliseconds(200))) {
+            if (settings.show_progress) {
+                std::cerr << "\rTiles done: " << items_done.load(std::memory_order_relaxed)
+                          << "/" << total_items << std::flush;
+            }
+        }
+        if (settings.show_progress) {
+            std::cerr << "\rTiles done: " << total_items << "/" << total_items << std::endl;
+        }
+
+        // 3) 合并样本段并求平均
+        framebuffer.assign(total_pixels, Vector3f(0.0f));
+        float inv_spp = 1.0f / static_cast<float>(spp);
+        for (int p = 0; p < total_pixels; ++p) {
+            Vector3f sum = layers[p];
+            for (int k = 1; k < splits; ++k) {
+                sum += layers[static_cast<size_t>(k) * total_pixels + p];
+            }
+            framebuffer[p] = sum * inv_spp;
+        }
+        pixel_costs.assign(cost_layers.empty() ? 0 : total_pixels, PixelCost());
+        for (size_t i = 0; i < cost_layers.size(); ++i) {
+            pixel_costs[i % total_pixels].cycles += cost_layers[i].cycles;
+            pixel_costs[i % total_pixels].steps += cost_layers[i].steps;
+        }
+        pixel_aovs.assign(aov_layers.empty() ? 0 : total_pixels, PixelAov());
+        for (size_t i = 0; i < aov_layers.size(); ++i) {
+            addAov(pixel_aovs[i % total_pixels], aov_layers[i]);
+        }
+        for (PixelAov& a : pixel_aovs) scaleAov(a, inv_spp);
+        sample_counts.assign(total_pixels, static_cast<uint32_t>(spp));
+        total_samples = static_cast<uint64_t>(total_pixels) * spp;
+    }
+
+    // 每个像素实际用的样本数（与 framebuffer 同样的布局）
+    const std::vector<uint32_t>& sampleCounts() const { return sample_counts; }
+
+    uint64_t totalSamples() const { return total_samples; }
+
+    // 每个像素的开销（与 framebuffer 同样的布局），只有 settings.cost_map 时才有
+    const std::vector<PixelCost>& pixelCosts() const { return pixel_costs; }
+
+    // 每个像素的 AOV 均值（与 framebuffer 同样的布局），只有 settings.aov 时才有
+    const std::vector<PixelAov>& pixelAovs() const { return pixel_aovs; }
+
+private:
+    struct WorkItem {
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;  // 像素范围 [x0,x1) x [y0,y1)
+        int s0 = 0, s1 = 0;                  // 样本区间 [s0,s1)
+        int layer = 0;
+    };
+
+    // 自动切分样本时希望至少有这么多个任务
+    static constexpr int kMinWorkItems = 256;
+
+    // 自适应采样的像素统计：颜色和 + 亮度的 Welford 均值 / 二阶矩
+    struct PixelStats {
+        Vector3f sum;
+        float mean = 0.0f;
+        float m2 = 0.0f;
+        uint32_t count = 0;
+        PixelAov aov;  // settings.aov 时累加
+    };
+
+    // 相对误差的分母下限，避免很暗的像素因为除以接近 0 的均值而一直被判为未收敛
+    static constexpr float kErrorFloor = 0.01f;
+
+    const Scene& scene;
+    const Camera& camera;
+    RenderSettings settings;
+    std::vector<uint32_t> sample_counts;
+    std::vector<PixelCost> pixel_costs;
+    std::vector<PixelAov> pixel_aovs;
+    uint64_t total_samples = 0;
+
+    // 光线包覆盖的像素块
+    static constexpr int kPacketW = 4;
+    static constexpr int kPacketH = RayPacket::kSize / kPacketW;
+
+    // wavefront 模式一批最多追踪的路径数
+    static constexpr size_t kWavefrontBatch = 1 << 14;
+
+    // 逐条追踪一个样本；wavefront 积分器在这里（例如自适应采样）退化成等价的 castRayMIS
+    Vector3f trace(const Ray& r, Sampler& sampler, const Scene::PrimaryHit* primary = nullptr,
+                   Scene::Aov* aov = nullptr) const {
+        if (settings.integrator != IntegratorType::Path) {
+            return scene.castRayMIS(r, settings.max_depth, settings.rr_depth, sampler, primary, aov);
+        }
+        return scene.castRay(r, settings.max_depth, settings.rr_depth, sampler, primary, aov);
+    }
+
+    static void addAov(PixelAov& dst, const PixelAov& src) {
+        dst.albedo += src.albedo;
+        dst.normal += src.normal;
+        dst.depth += src.depth;
+        dst.lum2 += src.lum2;
+    }
+
+    static void addSampleAov(PixelAov& dst, const Scene::Aov& a, const Vector3f& L) {
+        const float y = luminance(L);
+        dst.albedo += a.albedo;
+        dst.normal += a.normal;
+        dst.depth += a.depth;
+        dst.lum2 += y * y;
+    }
+
+    static void scaleAov(PixelAov& a, float s) {
+        a.albedo = a.albedo * s;
+        a.normal = a.normal * s;
+        a.depth *= s;
+        a.lum2 *= s;
+    }
+
+    // out、cost、aov 与 framebuffer 同样布局；cost 非空时逐像素计时，aov 非空时累加 AOV
+    void renderItem(const WorkItem& w, Vector3f* out, PixelCost* cost, PixelAov* aov) const {
+        const int tile_w = w.x1 - w.x0;
+        const int tile_h = w.y1 - w.y0;
+        std::vector<Vector3f> local(static_cast<size_t>(tile_w) * tile_h);
+        std::vector<PixelAov> local_aov(aov ? local.size() : 0);
+        PixelAov* tile_aov = aov ? local_aov.data() : nullptr;
+        std::unique_ptr<Sampler> sampler = createSampler(settings.sampler, settings.seed);
+
+        if (cost) {
+            renderPixels(w, *sampler, local, cost, tile_aov);
+        } else if (settings.integrator == IntegratorType::Wavefront) {
+            renderWavefront(w, *sampler, local, tile_aov);
+        } else if (settings.packets) {
+            for (int by = w.y0; by < w.y1; by += kPacketH) {
+                for (int bx = w.x0; bx < w.x1; bx += kPacketW) {
+                    renderPacketBlock(w, bx, by, *sampler, local, tile_aov);
+                }
+            }
+        } else {
+            renderPixels(w, *sampler, local, nullptr, tile_aov);
+        }
+
+        for (int j = 0; j < tile_h; ++j) {
+            std::copy(local.begin() + j * tile_w, local.begin() + (j + 1) * tile_w,
+                      out + (w.y0 + j) * settings.width + w.x0);
+            if (aov) {
+                std::copy(local_aov.begin() + j * tile_w, local_aov.begin() + (j + 1) * tile_w,
+                          aov + (w.y0 + j) * settings.width + w.x0);
+            }
+        }
+    }
+
+    // 逐像素、逐样本追踪；cost 非空时把每个像素的周期数和遍历步数加进去
+    // tile_aov 是 tile 本地的 AOV 缓冲（与 local 同样布局），可以为空
+    void renderPixels(const WorkItem& w, Sampler& sampler, std::vector<Vector3f>& local, PixelCost* cost,
+                      PixelAov* tile_aov) const {
+        const int tile_w = w.x1 - w.x0;
+        for (int j = w.y0; j < w.y1; ++j) {
+            for (int i = w.x0; i < w.x1; ++i) {
+                Vector3f sum(0.0f);
+                PixelAov pixel_aov;
+                uint32_t pixel = static_cast<uint32_t>(j * settings.width + i);
+                const uint64_t cycles0 = cost ? cycleCount() : 0;
+                const uint64_t steps0 = cost ? traversalSteps() : 0;
+                for (int s = w.s0; s < w.s1; ++s) {
+                    // 样本值只取决于 (像素, 样本序号, 维度)，与调度无关
+                    sampler.startPixelSample(pixel, static_cast<uint32_t>(s));
+                    Ray r = camera.generateRay(i, j, settings.width, settings.height, sampler);
+                    Scene::Aov a;
+                    Vector3f L = trace(r, sampler, nullptr, tile_aov ? &a : nullptr);
+                    sum += L;
+                    if (tile_aov) addSampleAov(pixel_aov, a, L);
+                }
+                if (cost) {
+                    cost[pixel].cycles += cycleCount() - cycles0;
+                    cost[pixel].steps += traversalSteps() - steps0;
+                }
+                local[(j - w.y0) * tile_w + (i - w.x0)] = sum;
+                if (tile_aov) tile_aov[(j - w.y0) * tile_w + (i - w.x0)] = pixel_aov;
+            }
+        }
+    }
+
+    // 一个 4x2 像素块的 [s0, s1) 号样本：
+    // 同一样本序号的 8 条相机射线打成一个包求交，命中点的光源样本再打成一个阴影射线包，
+    // 结果交给积分器当作第一个顶点，后面的弹射各走各的。
+    // 采样维度与逐条追踪完全一致，所以两种方式得到同样的图像
+    void renderPacketBlock(const WorkItem& w, int bx, int by, Sampler& sampler,
+                           std::vector<Vector3f>& local, PixelAov* tile_aov) const {
+        const int tile_w = w.x1 - w.x0;
+        int px[RayPacket::kSize], py[RayPacket::kSize];
+        uint32_t valid = 0;
+        for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+            px[lane] = bx + lane % kPacketW;
+            py[lane] = by + lane / kPacketW;
+            if (px[lane] < w.x1 && py[lane] < w.y1) valid |= 1u << lane;
+        }
+
+        RayPacket packet, shadow;
+        HitRecord recs[RayPacket::kSize];
+        Scene::PrimaryHit primary[RayPacket::kSize];
+
+        for (int s = w.s0; s < w.s1; ++s) {
+            const uint32_t sample = static_cast<uint32_t>(s);
+            auto startLane = [&](int lane) {
+                sampler.startPixelSample(static_cast<uint32_t>(py[lane] * settings.width + px[lane]), sample);
+            };
+
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                packet.clearLane(lane);
+                if (valid & (1u << lane)) {
+                    startLane(lane);
+                    Ray r = camera.generateRay(px[lane], py[lane], settings.width, settings.height, sampler);
+                    packet.set(lane, r, std::numeric_limits<float>::max());
+                }
+                recs[lane] = HitRecord();
+            }
+            RayCounters::add(kRayCamera, simd::popcount(packet.active));
+            const uint32_t hit = scene.intersectPacket(packet, recs);
+
+            // 第一个顶点的光源样本，采样维度与积分器里 bounce 0 的光源采样相同
+            // max_depth 为 0 时积分器不做光源采样
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                shadow.clearLane(lane);
+                primary[lane].has_light = false;
+                if (!(hit & (1u << lane)) || settings.max_depth <= 0) continue;
+                const Material* mat = recs[lane].material;
+                if (mat && mat->isEmissive()) continue;
+
+                startLane(lane);
+                sampler.setDimension(SampleDims::bounce(0) + SampleDims::kLightSelect);
+                Scene::LightSample& ls = primary[lane].light;
+                primary[lane].has_light = scene.sampleLight(ls, sampler);
+                if (primary[lane].has_light) {
+                    Scene::ShadowRay sr = Scene::makeShadowRay(recs[lane], ls);
+                    if (Scene::facesLight(recs[lane], ls, sr)) {
+                        shadow.set(lane, sr.ray, sr.dist - EPSILON);
+                    }
+                }
+            }
+            RayCounters::add(kRayShadow, simd::popcount(shadow.active));
+            const uint32_t blocked = scene.occludedPacket(shadow);
+            PT_STAT_ADD(kStatShadowOccluded, simd::popcount(blocked));
+
+            // 相机射线没打中的像素是黑背景，与积分器一致，不用再调用积分器
+            for (uint32_t m = hit; m; m &= m - 1) {
+                int lane = simd::firstLane(m);
+                startLane(lane);
+                primary[lane].rec = recs[lane];
+                primary[lane].light_visible = !(blocked & (1u << lane));
+                const int idx = (py[lane] - w.y0) * tile_w + (px[lane] - w.x0);
+                Scene::Aov a;
+                Vector3f L = trace(packet.ray(lane), sampler, &primary[lane], tile_aov ? &a : nullptr);
+                local[idx] += L;
+                if (tile_aov) addSampleAov(tile_aov[idx], a, L);
+            }
+        }
+    }
+
+    // wavefront 模式：tile 内的 (像素, 样本) 按像素、再按样本序号编号，每 kWavefrontBatch 条路径一批；
+    // 每批追踪完按编号顺序累加，所以像素内的求和顺序与逐条追踪相同
+    void renderWavefront(const WorkItem& w, Sampler& sampler, std::vector<Vector3f>& local,
+                         PixelAov* tile_aov) const {
+        const int tile_w = w.x1 - w.x0;
+        const size_t spp = static_cast<size_t>(w.s1 - w.s0);
+        const size_t total = local.size() * spp;
+        WavefrontIntegrator integrator(scene, settings.max_depth, settings.rr_depth, tile_aov != nullptr);
+
+        for (size_t begin = 0; begin < total; begin += kWavefrontBatch) {
+            const size_t end = std::min(total, begin + kWavefrontBatch);
+            integrator.clear();
+            for (size_t k = begin; k < end; ++k) {
+                const int p = static_cast<int>(k / spp);
+                const int i = w.x0 + p % tile_w;
+                const int j = w.y0 + p / tile_w;
+                const uint32_t pixel = static_cast<uint32_t>(j * settings.width + i);
+                const uint32_t s = static_cast<uint32_t>(w.s0 + k % spp);
+                sampler.startPixelSample(pixel, s);
+                Ray r = camera.generateRay(i, j, settings.width, settings.height, sampler);
+                integrator.addPath(pixel, s, r);
+            }
+            integrator.run(sampler);
+            for (size_t k = begin; k < end; ++k) {
+                const uint32_t path = static_cast<uint32_t>(k - begin);
+                local[k / spp] += integrator.pathRadiance(path);
+                if (tile_aov) addSampleAov(tile_aov[k / spp], integrator.pathAov(path), integrator.pathRadiance(path));
+            }
+        }
+    }
+
+    static float luminance(const Vector3f& c) {
+        return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z;
+    }
+
+    // 像素均值的标准误差除以 sqrt(均值)：输出做了 sqrt gamma，这近似于显示空间里的误差；
+    // 样本不足两个时视为无穷大
+    static float relativeError(const PixelStats& ps) {
+        if (ps.count < 2) return std::numeric_limits<float>::max();
+        float n = static_cast<float>(ps.count);
+        float std_err = std::sqrt(ps.m2 / ((n - 1.0f) * n));
+        return std_err / std::sqrt(std::max(ps.mean, 0.0f) + kErrorFloor);
+    }
+
+    // 自适应采样：先给每个像素 min_spp 个样本，之后每一轮挑出误差超过阈值的像素，
+    // 按误差从大到小让它们的样本数翻倍，直到全部收敛、达到 max_spp 或总预算用完。
+    // 样本序号在像素内连续，所以 Sobol 序列仍按 2 的幂的前缀使用
+    void renderAdaptive(ThreadPool& pool, std::vector<Vector3f>& framebuffer) {
+        const int width = settings.width;
+        const int height = settings.height;
+        const int spp = settings.samples_per_pixel;
+        const int tile = std::max(1, settings.tile_size);
+        const int total_pixels = width * height;
+        const uint64_t budget = static_cast<uint64_t>(total_pixels) * spp;
+
+        int max_spp = settings.max_spp > 0 ? settings.max_spp : spp * 8;
+        int min_spp = settings.min_spp > 0 ? settings.min_spp : std::max(4, spp / 4);
+        min_spp = std::max(1, std::min(min_spp, std::min(spp, max_spp)));
+
+        std::vector<WorkItem> tiles;
+        for (int y0 = 0; y0 < height; y0 += tile) {
+            for (int x0 = 0; x0 < width; x0 += tile) {
+                WorkItem w;
+                w.x0 = x0;
+                w.y0 = y0;
+                w.x1 = std::min(width, x0 + tile);
+                w.y1 = std::min(height, y0 + tile);
+                tiles.push_back(w);
+            }
+        }
+
+        std::vector<PixelStats> stats(total_pixels);
+        pixel_costs.assign(settings.cost_map ? total_pixels : 0, PixelCost());
+        std::vector<uint32_t> pass_samples(total_pixels, static_cast<uint32_t>(min_spp));
+        uint64_t used = 0;
+        std::vector<float> pixel_error(total_pixels);
+        std::vector<std::pair<float, int>> active;
+
+        for (int pass = 0; ; ++pass) {
+            uint64_t planned = 0;
+            for (uint32_t n : pass_samples) planned += n;
+            if (settings.show_progress) {
+                std::cerr << "Adaptive pass " << pass << ": "
+                          << planned << " samples (" << used + planned << "/" << budget << ")\n";
+            }
+            runAdaptivePass(pool, tiles, stats, pass_samples, pixel_costs.empty() ? nullptr : pixel_costs.data());
+            used += planned;
+
+            // 选出下一轮要加样本的像素
+            uint64_t remaining = budget - used;
+            if (remaining == 0) break;
+
+            // 少量样本时单个像素的方差估计很不可靠（例如几个样本恰好全是 0），
+            // 所以取 3x3 邻域内的最大误差，一个像素只有在周围也收敛时才停
+            for (int p = 0; p < total_pixels; ++p) pixel_error[p] = relativeError(stats[p]);
+            active.clear();
+            for (int j = 0; j < height; ++j) {
+                for (int i = 0; i < width; ++i) {
+                    const int p = j * width + i;
+                    if (stats[p].count >= static_cast<uint32_t>(max_spp)) continue;
+                    float err = 0.0f;
+                    for (int y = std::max(0, j - 1); y <= std::min(height - 1, j + 1); ++y) {
+                        for (int x = std::max(0, i - 1); x <= std::min(width - 1, i + 1); ++x) {
+                            err = std::max(err, pixel_error[y * width + x]);
+                        }
+                    }
+                    if (err > settings.adaptive_threshold) active.emplace_back(err, p);
+                }
+            }
+            if (active.empty()) break;
+
+            // 误差相同时按像素下标排，保证结果与线程数无关
+            std::sort(active.begin(), active.end(), [](const std::pair<float, int>& a,
+                                                       const std::pair<float, int>& b) {
+                return a.first != b.first ? a.first > b.first : a.second < b.second;
+            });
+
+            std::fill(pass_samples.begin(), pass_samples.end(), 0u);
+            uint64_t assigned = 0;
+            for (const auto& a : active) {
+                uint32_t n = stats[a.second].count;
+                uint64_t add = std::min<uint64_t>(n, static_cast<uint32_t>(max_spp) - n);
+                add = std::min<uint64_t>(add, remaining - assigned);
+                if (add == 0) break;
+                pass_samples[a.second] = static_cast<uint32_t>(add);
+                assigned += add;
+            }
+        }
+
+        framebuffer.assign(total_pixels, Vector3f(0.0f));
+        sample_counts.assign(total_pixels, 0u);
+        pixel_aovs.assign(settings.aov ? total_pixels : 0, PixelAov());
+        for (int p = 0; p < total_pixels; ++p) {
+            sample_counts[p] = stats[p].count;
+            if (stats[p].count > 0) {
+                framebuffer[p] = stats[p].sum / static_cast<float>(stats[p].count);
+                if (settings.aov) {
+                    pixel_aovs[p] = stats[p].aov;
+                    scaleAov(pixel_aovs[p], 1.0f / static_cast<float>(stats[p].count));
+                }
+            }
+        }
+        total_samples = used;
+    }
+
+    // 每个 tile 一个任务，给 tile 内的像素各追加 pass_samples[p] 个样本
+    // 每个像素只由一个任务写，样本按序号顺序累加；cost 非空时各轮的开销累加到同一个像素上
+    void runAdaptivePass(ThreadPool& pool, const std::vector<WorkItem>& tiles,
+                         std::vector<PixelStats>& stats,
+                         const std::vector<uint32_t>& pass_samples, PixelCost* cost) const {
+        TaskGroup group;
+        for (const WorkItem& w : tiles) {
+            pool.submit(group, [this, w, &stats, &pass_samples, cost](int) {
+                std::unique_ptr<Sampler> sampler = createSampler(settings.sampler, settings.seed);
+                for (int j = w.y0; j < w.y1; ++j) {
+                    for (int i = w.x0; i < w.x1; ++i) {
+                        const int p = j * settings.width + i;
+                        PixelStats& ps = stats[p];
+                        const uint32_t end = ps.count + pass_samples[p];
+                        if (end == ps.count) continue;
+                        const uint64_t cycles0 = cost ? cycleCount() : 0;
+                        const uint64_t steps0 = cost ? traversalSteps() : 0;
+                        for (uint32_t s = ps.count; s < end; ++s) {
+                            sampler->startPixelSample(static_cast<uint32_t>(p), s);
+                            Ray r = camera.generateRay(i, j, settings.width, settings.height, *sampler);
+                            Scene::Aov a;
+                            Vector3f L = trace(r, *sampler, nullptr, settings.aov ? &a : nullptr);
+                            if (settings.aov) addSampleAov(ps.aov, a, L);
+
+                            ps.sum += L;
+                            ++ps.count;
+                            float y = luminance(L);
+                            float delta = y - ps.mean;
+                            ps.mean += delta / static_cast<float>(ps.count);
+                            ps.m2 += delta * (y - ps.mean);
+                        }
+                        if (cost) {
+                            cost[p].cycles += cycleCount() - cycles0;
+                            cost[p].steps += traversalSteps() - steps0;
+                        }
+                    }
+                }
+            });
+        }
+        pool.wait(group);
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// 很薄的一层 SIMD 封装，只提供宽 BVH 遍历用到的运算
+// vfloat<4> 用 SSE，vfloat<8> 用 AVX（只有 SSE 时由两个 4 宽拼成）；没有对应指令集（例如 Apple Silicon）或定义了
+// PT_SIMD_SCALAR 时退回到逐分量的通用实现，由编译器自行向量化
+#if !defined(PT_SIMD_SCALAR)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define PT_SIMD_SSE 1
+#    include <emmintrin.h>
+#  endif
+#  if defined(__AVX__)
+#    define PT_SIMD_AVX 1
+#    include <immintrin.h>
+#  endif
+#endif
+
+// 宽 BVH 的分叉数：没有指定时按指令集选，有 AVX 用 8，否则用 4
+#ifndef PT_BVH_WIDTH
+#  if defined(PT_SIMD_AVX)
+#    define PT_BVH_WIDTH 8
+#  else
+#    define PT_BVH_WIDTH 4
+#  endif
+#endif
+
+namespace simd {
+
+// ---------------- 通用实现 ----------------
+
+template <int N>
+struct vmask {
+    bool m[N];
+
+    vmask operator & (const vmask& o) const { vmask r; for (int i = 0; i < N; ++i) r.m[i] = m[i] && o.m[i]; return r; }
+    vmask operator | (const vmask& o) const { vmask r; for (int i = 0; i < N; ++i) r.m[i] = m[i] || o.m[i]; return r; }
+
+    // 第 i 位对应第 i 个分量
+    uint32_t bits() const {
+        uint32_t b = 0;
+        for (int i = 0; i < N; ++i) b |= static_cast<uint32_t>(m[i]) << i;
+        return b;
+    }
+};
+
+template <int N>
+struct vfloat {
+    float v[N];
+
+    static vfloat load(const float* p) { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = p[i]; return r; }
+    static vfloat loadu(const float* p) { return load(p); }
+    static vfloat broadcast(float x) { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = x; return r; }
+    void store(float* p) const { for (int i = 0; i < N; ++i) p[i] = v[i]; }
+    void storeu(float* p) const { store(p); }
+
+    vfloat operator + (const vfloat& o) const { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = v[i] + o.v[i]; return r; }
+    vfloat operator - (const vfloat& o) const { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = v[i] - o.v[i]; return r; }
+    vfloat operator * (const vfloat& o) const { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = v[i] * o.v[i]; return r; }
+    vfloat operator / (const vfloat& o) const { vfloat r; for (int i = 0; i < N; ++i) r.v[i] = v[i] / o.v[i]; return r; }
+
+    vmask<N> operator <  (const vfloat& o) const { vmask<N> r; for (int i = 0; i < N; ++i) r.m[i] = v[i] <  o.v[i]; return r; }
+    vmask<N> operator <= (const vfloat& o) const { vmask<N> r; for (int i = 0; i < N; ++i) r.m[i] = v[i] <= o.v[i]; return r; }
+    vmask<N> operator >  (const vfloat& o) const { vmask<N> r; for (int i = 0; i < N; ++i) r.m[i] = v[i] >  o.v[i]; return r; }
+    vmask<N> operator >= (const vfloat& o) const { vmask<N> r; for (int i = 0; i < N; ++i) r.m[i] = v[i] >= o.v[i]; return r; }
+};
+
+// min/max 与 SSE 的 minps/maxps 语义一致：有 NaN 时返回第二个参数
+template <int N>
+inline vfloat<N> min(const vfloat<N>& a, const vfloat<N>& b) {
+    vfloat<N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r;
+}
+template <int N>
+inline vfloat<N> max(const vfloat<N>& a, const vfloat<N>& b) {
+    vfloat<N> r; for (int i = 0; i < N; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r;
+}
+template <int N>
+inline vfloat<N> abs(const vfloat<N>& a) {
+    vfloat<N> r; for (int i = 0; i < N; ++i) r.v[i] = std::fabs(a.v[i]); return r;
+}
+// mask 为真的分量取 a，否则取 b
+template <int N>
+inline vfloat<N> select(const vmask<N>& m, const vfloat<N>& a, const vfloat<N>& b) {
+    vfloat<N> r; for (int i = 0; i < N; ++i) r.v[i] = m.m[i] ? a.v[i] : b.v[i]; return r;
+}
+
+// ---------------- SSE：4 宽 ----------------
+#if defined(PT_SIMD_SSE)
+
+template <>
+struct vmask<4> {
+    __m128 m;
+
+    vmask operator & (const vmask& o) const { return {_mm_and_ps(m, o.m)}; }
+    vmask operator | (const vmask& o) const { return {_mm_or_ps(m, o.m)}; }
+    uint32_t bits() const { return static_cast<uint32_t>(_mm_movemask_ps(m)); }
+};
+
+template <>
+struct vfloat<4> {
+    __m128 v;
+
+    static vfloat load(const float* p) { return {_mm_load_ps(p)}; }
+    static vfloat loadu(const float* p) { return {_mm_loadu_ps(p)}; }
+    static vfloat broadcast(float x) { return {_mm_set1_ps(x)}; }
+    void store(float* p) const { _mm_store_ps(p, v); }
+    void storeu(float* p) const { _mm_storeu_ps(p, v); }
+
+    vfloat operator + (const vfloat& o) const { return {_mm_add_ps(v, o.v)}; }
+    vfloat operator - (const vfloat& o) const { return {_mm_sub_ps(v, o.v)}; }
+    vfloat operator * (const vfloat& o) const { return {_mm_mul_ps(v, o.v)}; }
+    vfloat operator / (const vfloat& o) const { return {_mm_div_ps(v, o.v)}; }
+
+    vmask<4> operator <  (const vfloat& o) const { return {_mm_cmplt_ps(v, o.v)}; }
+    vmask<4> operator <= (const vfloat& o) const { return {_mm_cmple_ps(v, o.v)}; }
+    vmask<4> operator >  (const vfloat& o) const { return {_mm_cmpgt_ps(v, o.v)}; }
+    vmask<4> operator >= (const vfloat& o) const { return {_mm_cmpge_ps(v, o.v)}; }
+};
+
+template <>
+inline vfloat<4> min(const vfloat<4>& a, const vfloat<4>& b) { return {_mm_min_ps(a.v, b.v)}; }
+template <>
+inline vfloat<4> max(const vfloat<4>& a, const vfloat<4>& b) { return {_mm_max_ps(a.v, b.v)}; }
+template <>
+inline vfloat<4> abs(const vfloat<4>& a) {
+    return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)};
+}
+template <>
+inline vfloat<4> select(const vmask<4>& m, const vfloat<4>& a, const vfloat<4>& b) {
+    return {_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))};
+}
+
+#endif
+
+// ---------------- AVX：8 宽 ----------------
+#if defined(PT_SIMD_AVX)
+
+template <>
+struct vmask<8> {
+    __m256 m;
+
+    vmask operator & (const vmask& o) const { return {_mm256_and_ps(m, o.m)}; }
+    vmask operator | (const vmask& o) const { return {_mm256_or_ps(m, o.m)}; }
+    uint32_t bits() const { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+};
+
+template <>
+struct vfloat<8> {
+    __m256 v;
+
+    static vfloat load(const float* p) { return {_mm256_load_ps(p)}; }
+    static vfloat loadu(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static vfloat broadcast(float x) { return {_mm256_set1_ps(x)}; }
+    void store(float* p) const { _mm256_store_ps(p, v); }
+    void storeu(float* p) const { _mm256_storeu_ps(p, v); }
+
+    vfloat operator + (const vfloat& o) const { return {_mm256_add_ps(v, o.v)}; }
+    vfloat operator - (const vfloat& o) const { return {_mm256_sub_ps(v, o.v)}; }
+    vfloat operator * (const vfloat& o) const { return {_mm256_mul_ps(v, o.v)}; }
+    vfloat operator / (const vfloat& o) const { return {_mm256_div_ps(v, o.v)}; }
+
+    vmask<8> operator <  (const vfloat& o) const { return {_mm256_cmp_ps(v, o.v, _CMP_LT_OQ)}; }
+    vmask<8> operator <= (const vfloat& o) const { return {_mm256_cmp_ps(v, o.v, _CMP_LE_OQ)}; }
+    vmask<8> operator >  (const vfloat& o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GT_OQ)}; }
+    vmask<8> operator >= (const vfloat& o) const { return {_mm256_cmp_ps(v, o.v, _CMP_GE_OQ)}; }
+};
+
+template <>
+inline vfloat<8> min(const vfloat<8>& a, const vfloat<8>& b) { return {_mm256_min_ps(a.v, b.v)}; }
+template <>
+inline vfloat<8> max(const vfloat<8>& a, const vfloat<8>& b) { return {_mm256_max_ps(a.v, b.v)}; }
+template <>
+inline vfloat<8> abs(const vfloat<8>& a) {
+    return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)};
+}
+template <>
+inline vfloat<8> select(const vmask<8>& m, const vfloat<8>& a, const vfloat<8>& b) {
+    return {_mm256_blendv_ps(b.v, a.v, m.m)};
+}
+
+#endif
+
+// ---------------- 只有 SSE 时：8 宽由两个 4 宽拼成 ----------------
+#if defined(PT_SIMD_SSE) && !defined(PT_SIMD_AVX)
+
+template <>
+struct vmask<8> {
+    vmask<4> lo, hi;
+
+    vmask operator & (const vmask& o) const { return {lo & o.lo, hi & o.hi}; }
+    vmask operator | (const vmask& o) const { return {lo | o.lo, hi | o.hi}; }
+    uint32_t bits() const { return lo.bits() | (hi.bits() << 4); }
+};
+
+template <>
+struct vfloat<8> {
+    vfloat<4> lo, hi;
+
+    static vfloat load(const float* p) { return {vfloat<4>::load(p), vfloat<4>::load(p + 4)}; }
+    static vfloat loadu(const float* p) { return {vfloat<4>::loadu(p), vfloat<4>::loadu(p + 4)}; }
+    static vfloat broadcast(float x) { return {vfloat<4>::broadcast(x), vfloat<4>::broadcast(x)}; }
+    void store(float* p) const { lo.store(p); hi.store(p + 4); }
+    void storeu(float* p) const { lo.storeu(p); hi.storeu(p + 4); }
+
+    vfloat operator + (const vfloat& o) const { return {lo + o.lo, hi + o.hi}; }
+    vfloat operator - (const vfloat& o) const { return {lo - o.lo, hi - o.hi}; }
+    vfloat operator * (const vfloat& o) const { return {lo * o.lo, hi * o.hi}; }
+    vfloat operator / (const vfloat& o) const { return {lo / o.lo, hi / o.hi}; }
+
+    vmask<8> operator <  (const vfloat& o) const { return {lo <  o.lo, hi <  o.hi}; }
+    vmask<8> operator <= (const vfloat& o) const { return {lo <= o.lo, hi <= o.hi}; }
+    vmask<8> operator >  (const vfloat& o) const { return {lo >  o.lo, hi >  o.hi}; }
+    vmask<8> operator >= (const vfloat& o) const { return {lo >= o.lo, hi >= o.hi}; }
+};
+
+template <>
+inline vfloat<8> min(const vfloat<8>& a, const vfloat<8>& b) { return {min(a.lo, b.lo), min(a.hi, b.hi)}; }
+template <>
+inline vfloat<8> max(const vfloat<8>& a, const vfloat<8>& b) { return {max(a.lo, b.lo), max(a.hi, b.hi)}; }
+template <>
+inline vfloat<8> abs(const vfloat<8>& a) { return {abs(a.lo), abs(a.hi)}; }
+template <>
+inline vfloat<8> select(const vmask<8>& m, const vfloat<8>& a, const vfloat<8>& b) {
+    return {select(m.lo, a.lo, b.lo), select(m.hi, a.hi, b.hi)};
+}
+
+#endif
+
+// 最低位的下标（mask 非 0）
+inline int firstLane(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits);
+#else
+    int i = 0;
+    while (!(bits & 1u)) { bits >>= 1; ++i; }
+    return i;
+#endif
+}
+
+// mask 里置位的个数
+inline int popcount(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(bits);
+#else
+    int n = 0;
+    for (; bits; bits &= bits - 1) ++n;
+    return n;
+#endif
+}
+
+} // namespace simd
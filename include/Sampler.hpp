@@ -0,0 +1,170 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "global.hpp"
+
+// 采样器接口：渲染器在每个 (像素, 样本) 开始时调用 startPixelSample，
+// 之后各处按固定的维度布局取随机数（见 SampleDims），保证同一路径顶点总是用同一组维度
+class Sampler {
+public:
+    virtual ~Sampler() = default;
+
+    virtual void startPixelSample(uint32_t pixel, uint32_t sample_index) = 0;
+
+    // 跳到第 dim 个维度（每次 get1D / get2D 调用占用一个维度）
+    virtual void setDimension(uint32_t dim) = 0;
+
+    virtual float get1D() = 0;
+    virtual Vector2f get2D() = 0;
+};
+
+// 维度布局：0 号给像素抖动，之后每个路径顶点固定占 kPerBounce 个
+struct SampleDims {
+    static constexpr uint32_t kPixel = 0;
+
+    static constexpr uint32_t kLightSelect = 0;  // 1D：选光源三角形
+    static constexpr uint32_t kLightPoint  = 1;  // 2D：三角形上的点
+    static constexpr uint32_t kBsdfLobe    = 2;  // 1D：选 diffuse / specular lobe
+    static constexpr uint32_t kBsdfDir     = 3;  // 2D：方向
+    static constexpr uint32_t kRoulette    = 4;  // 1D：俄罗斯轮盘
+    static constexpr uint32_t kPerBounce   = 5;
+
+    static uint32_t bounce(int b) { return 1 + static_cast<uint32_t>(b) * kPerBounce; }
+};
+
+// 纯随机采样器：每个维度从计数器 RNG 里取，用来和低差异序列做对比
+class RandomSampler : public Sampler {
+public:
+    explicit RandomSampler(uint32_t seed = 0) : seed(seed) {}
+
+    void startPixelSample(uint32_t pixel, uint32_t sample_index) override {
+        rng = RNG(pixel, sample_index, seed);
+    }
+
+    // 每个维度预留两个计数，2D 维度也不会和下一个维度重叠
+    void setDimension(uint32_t dim) override { rng.setDimension(2 * dim); }
+
+    float get1D() override {
+        float x = rng.nextFloat();
+        rng.nextUInt();
+        return x;
+    }
+
+    Vector2f get2D() override {
+        float x = rng.nextFloat();
+        float y = rng.nextFloat();
+        return Vector2f(x, y);
+    }
+
+private:
+    uint32_t seed;
+    RNG rng;
+};
+
+// Owen 置乱的 Sobol 采样器（Burley 2020, "Practical Hash-based Owen Scrambling"）
+// 只用 Sobol 的前两维：每个维度用哈希把样本序号打乱（padding），再各自做嵌套均匀置乱，
+// 这样任意多个维度都保持良好的 2D 分层，且各像素之间互不相关
+class SobolSampler : public Sampler {
+public:
+    explicit SobolSampler(uint32_t seed = 0) : seed(seed) {}
+
+    void startPixelSample(uint32_t pixel, uint32_t sample_index) override {
+        pixel_hash = hashCombine(hash32(pixel), seed);
+        index = sample_index;
+        dimension = 0;
+    }
+
+    void setDimension(uint32_t dim) override { dimension = dim; }
+
+    float get1D() override {
+        uint32_t h = hashCombine(pixel_hash, dimension++);
+        uint32_t i = nestedUniformScramble(index, h);
+        return toFloat(nestedUniformScramble(sobol0(i), hash32(h ^ 0x2c1b3c6du)));
+    }
+
+    Vector2f get2D() override {
+        uint32_t h = hashCombine(pixel_hash, dimension++);
+        uint32_t i = nestedUniformScramble(index, h);
+        float x = toFloat(nestedUniformScramble(sobol0(i), hash32(h ^ 0x2c1b3c6du)));
+        float y = toFloat(nestedUniformScramble(sobol1(i), hash32(h ^ 0x297a2d39u)));
+        return Vector2f(x, y);
+    }
+
+private:
+    uint32_t seed;
+    uint32_t pixel_hash = 0;
+    uint32_t index = 0;
+    uint32_t dimension = 0;
+
+    static float toFloat(uint32_t x) {
+        return static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+    }
+
+    static uint32_t reverseBits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    // Sobol 第 0 维：位反转（van der Corput）
+    static uint32_t sobol0(uint32_t i) { return reverseBits(i); }
+
+    // Sobol 第 1 维：方向数 v_k 由 v_{k+1} = v_k ^ (v_k >> 1) 生成
+    static uint32_t sobol1(uint32_t i) {
+        uint32_t result = 0;
+        uint32_t v = 1u << 31;
+        while (i) {
+            if (i & 1u) result ^= v;
+            i >>= 1;
+            v ^= v >> 1;
+        }
+        return result;
+    }
+
+    // Laine-Karras 风格的哈希置换，只影响更低的位，在位反转空间里等价于 Owen 置乱
+    static uint32_t laineKarras(uint32_t x, uint32_t s) {
+        x += s;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t nestedUniformScramble(uint32_t x, uint32_t s) {
+        return reverseBits(laineKarras(reverseBits(x), s));
+    }
+
+    static uint32_t hash32(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t hashCombine(uint32_t a, uint32_t b) {
+        return hash32(a ^ (b + 0x9e3779b9u + (a << 6) + (a >> 2)));
+    }
+};
+
+enum class SamplerType {
+    Random,
+    Sobol
+};
+
+inline std::unique_ptr<Sampler> createSampler(SamplerType type, uint32_t seed) {
+    if (type == SamplerType::Random) {
+        return std::unique_ptr<Sampler>(new RandomSampler(seed));
+    }
+    return std::unique_ptr<Sampler>(new SobolSampler(seed));
+}
+
+inline const char* samplerName(SamplerType type) {
+    return type == SamplerType::Random ? "random" : "sobol";
+}
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "Object.hpp"
 #include "Material.hpp"
 #include "Triangle.hpp"
-
+#include "MeshTriangle.hpp"
+#include "Instance.hpp"
+#include "Transform.hpp"
+#include "BVH.hpp"
+#include "AliasTable.hpp"
+#include "RayCounters.hpp"
+#include "Stats.hpp"
+
+// 场景的求交是两层的：顶层 BVH（tlas）建在各物体的世界包围盒上，叶子里是物体；
+// 每个物体自己的加速结构（例如 MeshTriangle 的 BVH）是底层。Instance 让多个物体共享同一份底层几何
 class Scene {
 public:
     Scene() = default;
@@ -13,27 +23,135 @@ public:
         objects.push_back(obj);
     }
 
-    // 光源统一用 Triangle* 存
+    // 加入 geometry 的一个实例；同一个 geometry 可以加多次，几何只存一份
+    // 发光的网格还要用同一个变换调用 addLightsFromMesh
+    Instance* addInstance(std::shared_ptr<const Object> geometry, const Transform& to_world) {
+        Instance* inst = new Instance(std::move(geometry), to_world);
+        objects.push_back(inst);
+        return inst;
+    }
+
+    // 单独的 Triangle 光源（同时作为可求交物体）
     void addLight(Object* light) {
         lights.push_back(light);
         objects.push_back(light);
     }
 
-    // 允许直接从 MeshTriangle 收集 emissive tris
-    void addLightsFromMesh(const std::vector<Object*>& mesh_lights) {
-        for (auto l : mesh_lights) {
-            lights.push_back(l);
+    // 直接从 MeshTriangle 收集发光面（mesh 本身通过 addObject / addInstance 加入）
+    // 光源表在 commit 时压平成世界空间的三角形，之后移动发光的实例需要重新搭建场景
+    void addLightsFromMesh(const MeshTriangle& mesh, const Transform& to_world = Transform()) {
+        for (uint32_t face : mesh.getEmissiveFaces()) {
+            Vector3f v0, v1, v2;
+            mesh.getFaceVertices(face, v0, v1, v2);
+            addLightTriangle(to_world.point(v0), to_world.point(v1), to_world.point(v2),
+                             mesh.getFaceMaterial(face));
         }
     }
 
+    // 登记一个三角形光源，commit 时生效
+    void addLightTriangle(const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+                          const Material* mat) {
+        float a = 0.5f * cross(v1 - v0, v2 - v0).length();
+        if (a <= 0.0f || !mat || !mat->isEmissive()) return;
+
+        LightTriangle lt;
+        lt.v0 = v0;
+        lt.e1 = v1 - v0;
+        lt.e2 = v2 - v0;
+        lt.normal = cross(lt.e1, lt.e2).normalized();
+        lt.emission = mat->emission();
+        lt.two_sided = mat->m_two_sided;
+        light_tris.push_back(lt);
+        light_areas.push_back(a);
+    }
+
+    // 场景搭建完成后、渲染前调用一次：等各物体的异步加载完成，
+    // 把 addLight 加入的 Triangle 光源也压平，并按面积建别名表
+    void commit() {
+        for (auto obj : objects) obj->finishLoading();
+        for (auto obj : lights) {
+            Triangle* tri = dynamic_cast<Triangle*>(obj);
+            if (!tri) continue;
+            addLightTriangle(tri->getV0(), tri->getV1(), tri->getV2(), tri->getMaterial());
+        }
+        lights.clear();
+        light_table.build(light_areas);
+        total_light_area = light_table.totalWeight();
+        rebuildTopLevel();
+    }
+
+    // 加减物体或物体移动很多之后重建顶层 BVH；各物体的底层结构不动
+    void rebuildTopLevel() {
+        tlas.build(objectBounds());
+    }
+
+    // 移动了实例（Instance::setTransform）之后调用：只更新顶层 BVH 的包围盒，树的结构不变
+    void refitTopLevel() {
+        tlas.refit(objectBounds());
+    }
+
+    // 只有一个物体时顶层只是多测一次包围盒，直接交给该物体
     bool intersect(const Ray& ray, HitRecord& rec) const {
-        bool hit_anything = false;
-        for (const auto& obj : objects) {
-            if (obj->intersect(ray, rec)) {
-                hit_anything = true;
+        if (objects.size() == 1) return objects[0]->intersect(ray, rec);
+        return tlas.intersect(ray, rec, [&](uint32_t i) {
+            return objects[i]->intersect(ray, rec);
+        });
+    }
+
+    // 阴影射线：(0, t_max) 内有任意遮挡即返回
+    bool occluded(const Ray& ray, float t_max) const {
+        if (objects.size() == 1) return objects[0]->occluded(ray, t_max);
+        return tlas.occluded(ray, t_max, [&](uint32_t i) {
+            return objects[i]->occluded(ray, t_max);
+        });
+    }
+
+    // 光线包版本的 intersect：recs[lane] 为各射线的最近交点，返回命中的射线掩码
+    // 方向不够一致的包退回逐条求交
+    uint32_t intersectPacket(RayPacket& packet, HitRecord* recs) const {
+        uint32_t hits = 0;
+        if (!packet.coherent(kPacketCoherence)) {
+            for (uint32_t m = packet.active; m; m &= m - 1) {
+                int lane = simd::firstLane(m);
+                recs[lane].t = packet.t_max[lane];
+                if (intersect(packet.ray(lane), recs[lane])) {
+                    packet.t_max[lane] = recs[lane].t;
+                    hits |= 1u << lane;
+                }
             }
+            return hits;
         }
-        return hit_anything;
+        if (objects.size() == 1) return objects[0]->intersectPacket(packet, recs);
+        // 顶层遍历给出的 mask 是碰到该物体包围盒的射线，只把它们交给物体
+        const uint32_t active = packet.active;
+        tlas.intersectPacket(packet, [&](uint32_t i, uint32_t mask) {
+            packet.active = mask;
+            hits |= objects[i]->intersectPacket(packet, recs);
+            packet.active = active;
+        });
+        return hits;
+    }
+
+    // 光线包版本的 occluded：返回被遮挡的射线掩码，已经被挡住的射线不再测后面的物体
+    // 方向不够一致的包（例如指向不同光源的阴影射线）退回逐条测试
+    uint32_t occludedPacket(const RayPacket& packet) const {
+        if (!packet.coherent(kPacketCoherence)) {
+            uint32_t blocked = 0;
+            for (uint32_t m = packet.active; m; m &= m - 1) {
+                int lane = simd::firstLane(m);
+                if (occluded(packet.ray(lane), packet.t_max[lane])) {
+                    blocked |= 1u << lane;
+                }
+            }
+            return blocked;
+        }
+
+        if (objects.size() == 1) return objects[0]->occludedPacket(packet);
+        RayPacket sub = packet;
+        return tlas.occludedPacket(packet, [&](uint32_t i, uint32_t mask) {
+            sub.active = mask;
+            return objects[i]->occludedPacket(sub);
+        });
     }
 
     struct LightSample {
@@ -41,146 +159,329 @@ public:
         Vector3f normal;
         Vector3f emission;
         float pdf; // area pdf
+        bool two_sided;
     };
 
-    // 对所有 Triangle 光源按面积采样
-    bool sampleLight(LightSample& ls) const {
-        if (lights.empty()) return false;
+    // 按面积采样光源三角形（需要先 commit）
+    // 从 sampler 的当前维度依次取选光源（1D）和三角形上的点（2D）
+    bool sampleLight(LightSample& ls, Sampler& sampler) const {
+        if (light_table.empty()) return false;
 
-        // 首先收集所有光源三角形及其面积和总面积
-        std::vector<Triangle*> tris;
-        tris.reserve(lights.size());
-        float total_area = 0.0f;
+        const LightTriangle& lt = light_tris[light_table.sample(sampler.get1D())];
 
-        for (auto obj : lights) {
-            Triangle* tri = dynamic_cast<Triangle*>(obj);
-            if (!tri) continue;
-            float a = tri->area();
-            if (a <= 0.0f) continue;
-            tris.push_back(tri);
-            total_area += a;
-        }
-
-        if (tris.empty() || total_area <= 0.0f) return false;
+        Vector2f u = sampler.get2D();
+        float r1 = u.x;
+        float r2 = u.y;
+        float sqrt_r1 = std::sqrt(r1);
 
-        float r = randFloat() * total_area;
-        Triangle* chosen = nullptr;
-        for (auto tri : tris) {
-            float a = tri->area();
-            if (r <= a) {
-                chosen = tri;
-                break;
-            }
-            r -= a;
-        }
-        if (!chosen) chosen = tris.back();
+        // 重心坐标 (1 - sqrt_r1, r2 * sqrt_r1, w)，相对 v0 展开
+        float v = r2 * sqrt_r1;
+        float w = sqrt_r1 - v;
+
+        ls.position = lt.v0 + v * lt.e1 + w * lt.e2;
+        ls.normal = lt.normal;
+        ls.emission = lt.emission;
+        ls.pdf = 1.0f / total_light_area;
+        ls.two_sided = lt.two_sided;
+        PT_STAT_ADD(kStatLightSamples, 1);
+        return true;
+    }
 
-        Vector3f v0 = chosen->getV0();
-        Vector3f v1 = chosen->getV1();
-        Vector3f v2 = chosen->getV2();
+    // 顶点 rec 到光源样本 ls 的阴影射线，可见性用 occluded(ray, dist - EPSILON) 判断
+    // 方向和距离都从偏移后的起点算，否则射线会在 dist - EPSILON 之前打到光源自身
+    struct ShadowRay {
+        Ray ray;
+        float dist;
+        float dist2;
+    };
 
-        float r1 = randFloat();
-        float r2 = randFloat();
-        float sqrt_r1 = std::sqrt(r1);
+    static ShadowRay makeShadowRay(const HitRecord& rec, const LightSample& ls) {
+        Vector3f shadow_origin = rec.p + rec.N * EPSILON;
+        Vector3f light_dir = ls.position - shadow_origin;
+        ShadowRay sr;
+        sr.dist2 = light_dir.length2();
+        sr.dist = std::sqrt(sr.dist2);
+        sr.ray = Ray(shadow_origin, light_dir / sr.dist);
+        return sr;
+    }
 
-        float u = 1.0f - sqrt_r1;
-        float v = r2 * sqrt_r1;
-        float w = 1.0f - u - v;
+    // 光源样本在顶点法线正面且光源朝向顶点时才可能有贡献，否则积分器不会用到这条阴影射线
+    static bool facesLight(const HitRecord& rec, const LightSample& ls, const ShadowRay& sr) {
+        float cos_theta = dot(rec.N, sr.ray.direction);
+        float cos_light = dot(ls.normal, -sr.ray.direction);
+        if (ls.two_sided) cos_light = std::fabs(cos_light);
+        return cos_theta > 0.0f && cos_light > 0.0f && ls.pdf > 0.0f;
+    }
 
-        Vector3f p = u * v0 + v * v1 + w * v2;
+    // 相机一个像素的张角，射线锥的扩散角（见 Camera::pixelSpreadAngle）；0 表示贴图总是取最精细的一层
+    void setPixelSpread(float angle) { pixel_spread = angle; }
 
-        Vector3f N = cross(v1 - v0, v2 - v0).normalized();
-        Material* mat = chosen->getMaterial();
-        Vector3f Le(0.0f);
-        if (mat && mat->isEmissive()) {
-            Le = mat->emission();
+    // 射线锥：锥在交点处的宽度约为 张角 * 路径长度（不考虑表面曲率，漫反射后也不再放大），
+    // 投影到表面上除以 |cos|，再乘 uv 密度得到 uv 空间里的宽度。掠射时 |cos| 限制在 kMinFootprintCos 以上
+    void setTextureFootprint(HitRecord& rec, const Vector3f& dir, float path_length) const {
+        if (rec.uv_density <= 0.0f || pixel_spread <= 0.0f) {
+            rec.uv_footprint = 0.0f;
+            return;
         }
+        float cos_theta = std::max(std::fabs(dot(rec.N, dir)), kMinFootprintCos);
+        rec.uv_footprint = pixel_spread * path_length * rec.uv_density / cos_theta;
+    }
 
-        ls.position = p;
-        ls.normal = N;
-        ls.emission = Le;
-        ls.pdf = 1.0f / total_area;
-        return true;
+    // 相机射线第一个交点的辅助信息（AOV），降噪器用它区分边缘；没打中时全为 0
+    struct Aov {
+        Vector3f albedo;
+        Vector3f normal;
+        float depth = 0.0f;
+    };
+
+    static void fillAov(const HitRecord& rec, Aov& aov) {
+        const Material* mat = rec.material ? rec.material : default_gray();
+        aov.albedo = mat->albedo(rec.uv, rec.uv_footprint);
+        aov.normal = rec.N;
+        aov.depth = rec.t;
     }
 
-    Vector3f castRay(const Ray& ray, int depth) const {
-        if (depth <= 0) {
-            return Vector3f(0.0f);
-        }
+    // 积分器里逐条追踪的射线走这两个函数，顺便按类型计数（见 RayCounters）
+    bool traceRay(const Ray& ray, HitRecord& rec, int bounce) const {
+        RayCounters::add(bounce == 0 ? kRayCamera : kRayBounce);
+        return intersect(ray, rec);
+    }
+
+    bool shadowVisible(const ShadowRay& sr) const {
+        RayCounters::add(kRayShadow);
+        const bool blocked = occluded(sr.ray, sr.dist - EPSILON);
+        PT_STAT_ADD(kStatShadowOccluded, blocked ? 1 : 0);
+        return !blocked;
+    }
 
+    // 由光线包预先算好的第一个顶点：相机射线的交点、该顶点的光源样本（bounce 0 的光源维度）及其可见性
+    // 积分器拿到它就跳过第一次求交、光源采样和第一条阴影射线；相机射线未命中时不会调用积分器
+    struct PrimaryHit {
         HitRecord rec;
-        rec.t = std::numeric_limits<float>::max();
+        LightSample light;
+        bool has_light = false;
+        bool light_visible = false;
+    };
 
-        if (!intersect(ray, rec)) {
-            // 对标准 Cornell，一般用黑背景，这里先用黑
-            return Vector3f(0.0f);
+    // 顶点的光源样本：第一个顶点若已由光线包算好就直接用，否则在 dim 这组维度上采样
+    bool vertexLightSample(const PrimaryHit* pre, uint32_t dim, LightSample& ls, Sampler& sampler) const {
+        if (pre) {
+            ls = pre->light;
+            return pre->has_light;
         }
+        sampler.setDimension(dim + SampleDims::kLightSelect);
+        return sampleLight(ls, sampler);
+    }
 
-        Material* mat = rec.material;
-        if (!mat) {
-            mat = default_gray();
-        }
+    // 光源上任意一点的面积 pdf（按面积均匀采样，所以处处相同）
+    float lightAreaPdf() const {
+        return light_table.empty() ? 0.0f : 1.0f / total_light_area;
+    }
 
-        if (mat->isEmissive()) {
-            // 只在直接命中时返回 Le
-            return mat->emission();
+    // 俄罗斯轮盘：前 rr_depth 个顶点不做；之后以路径通量的最大分量（不超过 1）作为继续的概率，
+    // 存活的路径把通量除以这个概率。通量已经很小的路径大多在这里结束，通量大的路径不会被提前截断。
+    // 返回 false 表示路径结束
+    static bool russianRoulette(Vector3f& throughput, int bounce, int rr_depth, uint32_t dim,
+                                Sampler& sampler) {
+        if (bounce < rr_depth) return true;
+        float q = std::min(1.0f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+        sampler.setDimension(dim + SampleDims::kRoulette);
+        if (sampler.get1D() >= q) {
+            PT_STAT_ADD(kStatRouletteKills, 1);
+            return false;
         }
+        throughput /= q;
+        return true;
+    }
+
+    // 路径追踪：每个顶点做光源采样，再按 BSDF 采样下一段，打到光源时加上自发光后结束。
+    // 与原来的递归版本计算同样的量，只是改成循环并记录路径通量；
+    // 最多 max_depth 个顶点，第 rr_depth 个顶点起做俄罗斯轮盘；aov 非空时记下第一个交点的 AOV
+    Vector3f castRay(const Ray& camera_ray, int max_depth, int rr_depth, Sampler& sampler,
+                     const PrimaryHit* primary = nullptr, Aov* aov = nullptr) const {
+        Vector3f L(0.0f);
+        Vector3f throughput(1.0f);
+        Ray ray = camera_ray;
+        float path_length = 0.0f;  // 射线锥用：从相机到当前顶点的路径长度
+
+        for (int bounce = 0; bounce < max_depth; ++bounce) {
+            HitRecord rec;
+            rec.t = std::numeric_limits<float>::max();
+            const PrimaryHit* pre = (bounce == 0) ? primary : nullptr;
+            if (pre) {
+                rec = pre->rec;
+            } else if (!traceRay(ray, rec, bounce)) {
+                // 对标准 Cornell，一般用黑背景，这里先用黑
+                break;
+            }
+            PT_STAT_VERTEX(bounce);
+
+            path_length += rec.t;
+            setTextureFootprint(rec, ray.direction, path_length);
+            if (aov && bounce == 0) fillAov(rec, *aov);
+
+            Material* mat = rec.material;
+            if (!mat) {
+                mat = default_gray();
+            }
+
+            if (mat->isEmissive()) {
+                L += throughput * mat->emission();
+                break;
+            }
 
-        Vector3f Le = mat->emission();  // 一般为 0
-
-        // --- 直接光照 L_dir ---
-        Vector3f L_dir(0.0f);
-        LightSample ls;
-        if (sampleLight(ls) && (ls.emission.x > 0.0f || ls.emission.y > 0.0f || ls.emission.z > 0.0f)) {
-            Vector3f light_dir = ls.position - rec.p;
-            float dist2 = light_dir.length2();
-            float dist = std::sqrt(dist2);
-            light_dir /= dist;
-
-            // 阴影检测
-            Ray shadow_ray(rec.p + rec.N * EPSILON, light_dir);
-            HitRecord shadow_rec;
-            shadow_rec.t = dist - EPSILON;
-            if (!intersect(shadow_ray, shadow_rec)) {
-                Vector3f N = rec.N;
-                Vector3f wo = -ray.direction;
-                Vector3f wi = light_dir;
-
-                Vector3f f_r = mat->eval(wi, wo, N, rec.uv);
-                float cos_theta = std::max(0.0f, dot(N, wi));
-                float cos_theta_light = std::max(0.0f, dot(ls.normal, -wi));
-
-                if (ls.pdf > 0.0f && cos_theta_light > 0.0f) {
-                    L_dir = ls.emission * f_r * cos_theta * cos_theta_light / (ls.pdf * dist2);
+            Vector3f N = rec.N;
+            Vector3f wo = -ray.direction;
+            const uint32_t dim = SampleDims::bounce(bounce);
+
+            // --- 直接光照 L_dir ---
+            LightSample ls;
+            if (vertexLightSample(pre, dim, ls, sampler) && (ls.emission.x > 0.0f || ls.emission.y > 0.0f || ls.emission.z > 0.0f)) {
+                ShadowRay sr = makeShadowRay(rec, ls);
+                float dist2 = sr.dist2;
+                // 这里不管朝向都追踪阴影射线；统计按朝向算，与光线包和 MIS 的口径一致
+                PT_STAT_ADD(kStatLightRejected, facesLight(rec, ls, sr) ? 0 : 1);
+
+                // 阴影检测
+                bool visible = pre ? pre->light_visible
+                                   : shadowVisible(sr);
+                if (visible) {
+                    Vector3f wi = sr.ray.direction;
+
+                    Vector3f f_r = mat->eval(wi, wo, N, rec.uv, rec.uv_footprint);
+                    float cos_theta = std::max(0.0f, dot(N, wi));
+                    float cos_theta_light = std::max(0.0f, dot(ls.normal, -wi));
+
+                    if (ls.pdf > 0.0f && cos_theta_light > 0.0f) {
+                        L += throughput * ls.emission * f_r * cos_theta * cos_theta_light / (ls.pdf * dist2);
+                    }
                 }
             }
-        }
 
-        // --- 间接光照 L_indir ---
-        float rr_prob = 0.8f;
-        if (randFloat() > rr_prob) {
-            return Le + L_dir;
-        }
+            // --- 间接光照：BSDF 采样下一段 ---
+            float pdf = 0.0f;
+            sampler.setDimension(dim + SampleDims::kBsdfLobe);
+            Vector3f wi = mat->sample(N, wo, pdf, sampler);
+            if (pdf <= 0.0f) {
+                break;
+            }
 
-        float pdf = 0.0f;
-        Vector3f N = rec.N;
-        Vector3f wo = -ray.direction;
-        Vector3f wi = mat->sample(N, pdf);
+            Vector3f f_r = mat->eval(wi, wo, N, rec.uv, rec.uv_footprint);
+            float cos_theta = std::max(0.0f, dot(N, wi));
+            throughput = throughput * f_r * (cos_theta / pdf);
 
-        if (pdf <= 0.0f) {
-            return Le + L_dir;
+            if (!russianRoulette(throughput, bounce, rr_depth, dim, sampler)) {
+                break;
+            }
+            ray = Ray(rec.p + N * EPSILON, wi);
         }
 
-        Ray new_ray(rec.p + N * EPSILON, wi);
-        Vector3f Li = castRay(new_ray, depth - 1);
+        return L;
+    }
+
+    // 多重重要性采样（MIS）的路径追踪：
+    // 每个顶点同时做光源采样和 BSDF 采样，两种策略都可能采到光源，用 power heuristic 合并
+    // primary 非空时第一个顶点直接用光线包的结果；aov 同 castRay
+    Vector3f castRayMIS(const Ray& camera_ray, int max_depth, int rr_depth, Sampler& sampler,
+                        const PrimaryHit* primary = nullptr, Aov* aov = nullptr) const {
+        Vector3f L(0.0f);
+        Vector3f throughput(1.0f);
+        Ray ray = camera_ray;
+        float path_length = 0.0f;  // 射线锥用：从相机到当前顶点的路径长度
+        float prev_bsdf_pdf = 0.0f;  // 上一次 BSDF 采样的方向 pdf，0 表示相机射线
+
+        // 与 castRay 相同的路径空间：前 max_depth 个顶点做光源采样，
+        // 最后一次 BSDF 采样的射线仍然要求交，才能补上它在 MIS 中的那一份权重
+        for (int bounce = 0; bounce <= max_depth; ++bounce) {
+            HitRecord rec;
+            rec.t = std::numeric_limits<float>::max();
+            const PrimaryHit* pre = (bounce == 0) ? primary : nullptr;
+            if (pre) {
+                rec = pre->rec;
+            } else if (!traceRay(ray, rec, bounce)) {
+                break;
+            }
+            PT_STAT_VERTEX(bounce);
+
+            path_length += rec.t;
+            setTextureFootprint(rec, ray.direction, path_length);
+            if (aov && bounce == 0) fillAov(rec, *aov);
 
-        Vector3f f_r = mat->eval(wi, wo, N, rec.uv);
-        float cos_theta = std::max(0.0f, dot(N, wi));
+            Material* mat = rec.material;
+            if (!mat) {
+                mat = default_gray();
+            }
+
+            // BSDF 采样打到光源：按 BSDF pdf 与光源 pdf（换算到立体角）加权
+            if (mat->isEmissive()) {
+                if (rec.front_face || mat->m_two_sided) {
+                    float w = 1.0f;
+                    if (prev_bsdf_pdf > 0.0f) {
+                        float cos_light = std::fabs(dot(rec.N, ray.direction));
+                        float pdf_light = (cos_light > 0.0f)
+                            ? lightAreaPdf() * rec.t * rec.t / cos_light : 0.0f;
+                        w = powerHeuristic(prev_bsdf_pdf, pdf_light);
+                    }
+                    L += throughput * mat->emission() * w;
+                }
+                break;
+            }
+            if (bounce == max_depth) {
+                break;
+            }
+
+            Vector3f N = rec.N;
+            Vector3f wo = -ray.direction;
+            const uint32_t dim = SampleDims::bounce(bounce);
+
+            // --- 光源采样 ---
+            LightSample ls;
+            if (vertexLightSample(pre, dim, ls, sampler)) {
+                ShadowRay sr = makeShadowRay(rec, ls);
+                const Vector3f& light_dir = sr.ray.direction;
+                float dist2 = sr.dist2;
+
+                float cos_theta = dot(N, light_dir);
+                float cos_light = dot(ls.normal, -light_dir);
+                if (ls.two_sided) cos_light = std::fabs(cos_light);
+
+                if (cos_theta > 0.0f && cos_light > 0.0f && ls.pdf > 0.0f) {
+                    bool visible = pre ? pre->light_visible
+                                       : shadowVisible(sr);
+                    if (visible) {
+                        float pdf_light = ls.pdf * dist2 / cos_light;
+                        float pdf_bsdf = mat->pdf(light_dir, wo, N);
+                        float w = powerHeuristic(pdf_light, pdf_bsdf);
+                        Vector3f f_r = mat->eval(light_dir, wo, N, rec.uv, rec.uv_footprint);
+                        L += throughput * ls.emission * f_r * (cos_theta * w / pdf_light);
+                    }
+                } else {
+                    PT_STAT_ADD(kStatLightRejected, 1);
+                }
+            }
+
+            // --- BSDF 采样，继续下一段路径 ---
+            float pdf = 0.0f;
+            sampler.setDimension(dim + SampleDims::kBsdfLobe);
+            Vector3f wi = mat->sample(N, wo, pdf, sampler);
+            if (pdf <= 0.0f) {
+                break;
+            }
+            float cos_theta = dot(N, wi);
+            if (cos_theta <= 0.0f) {
+                break;
+            }
 
-        Vector3f L_indir = Li * f_r * (cos_theta / (pdf * rr_prob));
+            Vector3f f_r = mat->eval(wi, wo, N, rec.uv, rec.uv_footprint);
+            throughput = throughput * f_r * (cos_theta / pdf);
+            if (!russianRoulette(throughput, bounce, rr_depth, dim, sampler)) {
+                break;
+            }
+            prev_bsdf_pdf = pdf;
+            ray = Ray(rec.p + N * EPSILON, wi);
+        }
 
-        // return Le + L_dir;
-        return Le + L_dir + L_indir;
+        return L;
     }
 
     ~Scene() {
@@ -190,8 +491,41 @@ public:
     }
 
 private:
+    // wavefront 积分器与 castRayMIS 共用 powerHeuristic 和默认材质
+    friend class WavefrontIntegrator;
+
     std::vector<Object*> objects;
     std::vector<Object*> lights;
+    BVH tlas;  // 顶层 BVH，图元下标就是 objects 的下标
+
+    std::vector<AABB> objectBounds() const {
+        std::vector<AABB> b(objects.size());
+        for (size_t i = 0; i < objects.size(); ++i) b[i] = objects[i]->bounds();
+        return b;
+    }
+
+    // commit() 生成的光源数据：v0 + 两条边 + 法线，采样时不再访问 Triangle 对象
+    struct LightTriangle {
+        Vector3f v0, e1, e2;
+        Vector3f normal;
+        Vector3f emission;
+        bool two_sided;
+    };
+    std::vector<LightTriangle> light_tris;
+    std::vector<float> light_areas;
+    AliasTable light_table;
+    float total_light_area = 0.0f;
+    float pixel_spread = 0.0f;
+    static constexpr float kMinFootprintCos = 0.05f;
+
+    // 光线包内射线方向与第一条射线夹角的余弦下限，低于它就逐条追踪
+    static constexpr float kPacketCoherence = 0.99f;
+
+    static float powerHeuristic(float pdf_a, float pdf_b) {
+        float a2 = pdf_a * pdf_a;
+        float b2 = pdf_b * pdf_b;
+        return (a2 + b2 > 0.0f) ? a2 / (a2 + b2) : 0.0f;
+    }
 
     static Material* default_gray() {
         static Material gray(Vector3f(0.8f, 0.8f, 0.8f),
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include "global.hpp"
+
+// 自带的几个场景：OBJ 路径（相对于构建目录）和相机参数；path_tracer 和 path_tracer_bench 共用
+enum class SceneType {
+    CornellBox,
+    VeachMIS,
+    LivingRoom
+};
+
+struct SceneConfig {
+    std::string obj_path;
+    Vector3f    eye;
+    Vector3f    lookat;
+    Vector3f    up;
+    float       vfov;
+};
+
+inline SceneConfig makeSceneConfig(SceneType type) {
+    SceneConfig cfg{};
+
+    if (type == SceneType::CornellBox) {
+        cfg.obj_path = "../scene/cornell-box/scene.obj";
+
+        cfg.eye    = Vector3f(0.0f, 1.0f, 6.8f);
+        cfg.lookat = Vector3f(0.0f, 1.0f, 5.8f);
+        cfg.up     = Vector3f(0.0f, 1.0f, 0.0f);
+        cfg.vfov   = 19.5f;
+    } else if (type == SceneType::VeachMIS) {
+        cfg.obj_path = "../scene/veach-mis/scene.obj";
+
+        cfg.eye    = Vector3f(28.2792f, 3.5f, 0.000001f);
+        cfg.lookat = Vector3f(27.2792f, 3.5f, 0.000001f);
+        cfg.up     = Vector3f(0.0f,     1.0f, 0.0f);
+        cfg.vfov   = 35.0f; // 简化使用 fovx
+    } else if (type == SceneType::LivingRoom) {
+        cfg.obj_path = "../scene/living-room/scene.obj";
+        cfg.eye    = Vector3f(5.10518f, 0.731065f, -2.31789f);
+        cfg.lookat = Vector3f(4.143388f, 0.805472f, -2.054414f);
+        cfg.up     = Vector3f(0.071763f, 0.997228f, -0.019659f);
+        cfg.vfov   = 90.0f;
+    }
+
+    return cfg;
+}
+
+inline const char* sceneTypeName(SceneType type) {
+    switch (type) {
+        case SceneType::CornellBox: return "CornellBox";
+        case SceneType::VeachMIS: return "VeachMIS";
+        case SceneType::LivingRoom: return "LivingRoom";
+    }
+    return "Unknown";
+}
+
+// 命令行里的场景名：cornell / veach / living
+inline bool parseSceneType(const std::string& name, SceneType& type) {
+    if (name == "cornell") type = SceneType::CornellBox;
+    else if (name == "veach") type = SceneType::VeachMIS;
+    else if (name == "living") type = SceneType::LivingRoom;
+    else return false;
+    return true;
+}
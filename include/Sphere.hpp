@@ -11,27 +11,8 @@ public:
         : center(center), radius(radius), material(mat) {}
 
     bool intersect(const Ray& ray, HitRecord& rec) const override {
-        Vector3f oc = ray.origin - center;
-        float a = ray.direction.length2();
-        float half_b = dot(oc, ray.direction);
-        float c = oc.length2() - radius * radius;
-
-        float discriminant = half_b * half_b - a * c;
-        if (discriminant < 0.0f) {
-            return false;
-        }
-        float sqrt_discriminant = std::sqrt(discriminant);
-
-        // 找最近的 t
-        float t = (-half_b - sqrt_discriminant) / a;
-        if (t < EPSILON) {
-            t = (-half_b + sqrt_discriminant) / a;
-            if (t < EPSILON) {
-                return false;
-            }
-        }
-
-        if (t >= rec.t) {
+        float t;
+        if (!hitTest(ray, rec.t, t)) {
             return false;
         }
 
@@ -52,13 +33,49 @@ public:
         float v = theta / PI;
 
         rec.uv = Vector2f(u, v);
+        // 整个 uv 方块铺在 4πr² 的球面上，按平均值算
+        rec.uv_density = 0.5f / (radius * std::sqrt(PI));
         rec.material = material;
 
         return true;
     }
 
+    bool occluded(const Ray& ray, float t_max) const override {
+        float t;
+        return hitTest(ray, t_max, t);
+    }
+
+    AABB bounds() const override {
+        Vector3f r(radius, radius, radius);
+        return AABB(center - r, center + r);
+    }
+
 private:
     Vector3f center;
     float radius;
     Material* material;
+
+    // 求 (EPSILON, t_max) 内最近的 t
+    bool hitTest(const Ray& ray, float t_max, float& t) const {
+        Vector3f oc = ray.origin - center;
+        float a = ray.direction.length2();
+        float half_b = dot(oc, ray.direction);
+        float c = oc.length2() - radius * radius;
+
+        float discriminant = half_b * half_b - a * c;
+        if (discriminant < 0.0f) {
+            return false;
+        }
+        float sqrt_discriminant = std::sqrt(discriminant);
+
+        // 找最近的 t
+        t = (-half_b - sqrt_discriminant) / a;
+        if (t < EPSILON) {
+            t = (-half_b + sqrt_discriminant) / a;
+            if (t < EPSILON) {
+                return false;
+            }
+        }
+        return t < t_max;
+    }
 };
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include "RayCounters.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#  define PT_HAS_RDTSC 1
+#endif
+
+// 渲染统计：BVH 节点访问、图元求交次数、路径长度分布、俄罗斯轮盘、光源样本的去向
+// 编译时用 -DPT_ENABLE_STATS=1 打开（CMake 选项 PT_ENABLE_STATS）；关闭时 PT_STAT_* 宏展开为空，
+// 参数也不求值，遍历循环里没有任何额外代码。射线按类型的计数（RayCounters）始终开着，不归这里管
+// 计数方式与 RayCounters 相同：每个线程一块，渲染结束后求和
+#ifndef PT_ENABLE_STATS
+#define PT_ENABLE_STATS 0
+#endif
+
+enum StatCounter : int {
+    kStatNodeVisits,     // 处理过的 BVH 节点（测了孩子的包围盒或叶子里的图元），按射线计
+    kStatPrimTests,      // 射线与图元（三角形、顶层里的物体）的求交次数
+    kStatVertices,       // 路径顶点（交点）总数
+    kStatRouletteKills,  // 被俄罗斯轮盘结束的路径
+    kStatLightSamples,   // 光源采样次数
+    kStatLightRejected,  // 光源样本因朝向或 pdf 为 0 被丢掉，没有贡献也不算遮挡
+    kStatShadowOccluded, // 被挡住的阴影射线
+    kStatCounterCount
+};
+
+inline const char* statCounterName(StatCounter c) {
+    switch (c) {
+        case kStatNodeVisits: return "node_visits";
+        case kStatPrimTests: return "primitive_tests";
+        case kStatVertices: return "path_vertices";
+        case kStatRouletteKills: return "roulette_terminations";
+        case kStatLightSamples: return "light_samples";
+        case kStatLightRejected: return "light_samples_rejected";
+        case kStatShadowOccluded: return "shadow_rays_occluded";
+        default: return "unknown";
+    }
+}
+
+// reached[d]：有第 d + 1 个顶点的路径数（d 从 0 起），更深的顶点只计入 kStatVertices
+constexpr int kStatDepthBins = 16;
+
+struct StatsSnapshot {
+    uint64_t n[kStatCounterCount] = {};
+    uint64_t reached[kStatDepthBins] = {};
+};
+
+class RenderStats {
+public:
+    static void add(StatCounter counter, uint64_t count = 1) {
+        bumpCounter(Slots::local().n[counter], count);
+    }
+
+    // 路径的第 depth 个交点（depth 从 0 起）
+    static void addVertex(int depth) {
+        Slot& slot = Slots::local();
+        bumpCounter(slot.n[kStatVertices], 1);
+        if (depth < kStatDepthBins) bumpCounter(slot.reached[depth], 1);
+    }
+
+    // 当前线程的计数，用差值统计一段代码（例如一个像素）的开销
+    static uint64_t local(StatCounter counter) {
+        return Slots::local().n[counter].load(std::memory_order_relaxed);
+    }
+
+    static StatsSnapshot total() {
+        StatsSnapshot out;
+        Slots::forEach([&](const Slot& slot) {
+            for (int c = 0; c < kStatCounterCount; ++c) out.n[c] += slot.n[c].load(std::memory_order_relaxed);
+            for (int d = 0; d < kStatDepthBins; ++d) out.reached[d] += slot.reached[d].load(std::memory_order_relaxed);
+        });
+        return out;
+    }
+
+    // 只能在没有线程在渲染时调用
+    static void reset() {
+        Slots::forEach([](Slot& slot) {
+            for (auto& c : slot.n) c.store(0, std::memory_order_relaxed);
+            for (auto& c : slot.reached) c.store(0, std::memory_order_relaxed);
+        });
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> n[kStatCounterCount];
+        std::atomic<uint64_t> reached[kStatDepthBins];
+        Slot() {
+            for (auto& c : n) c.store(0, std::memory_order_relaxed);
+            for (auto& c : reached) c.store(0, std::memory_order_relaxed);
+        }
+    };
+    using Slots = PerThreadSlots<Slot>;
+};
+
+#if PT_ENABLE_STATS
+#define PT_STAT_ADD(counter, count) RenderStats::add((counter), (count))
+#define PT_STAT_VERTEX(depth) RenderStats::addVertex(depth)
+#else
+#define PT_STAT_ADD(counter, count) ((void)0)
+#define PT_STAT_VERTEX(depth) ((void)0)
+#endif
+
+// 当前线程到目前为止的遍历步数（BVH 节点访问 + 图元求交）；统计没有编译进来时总是 0
+inline uint64_t traversalSteps() {
+#if PT_ENABLE_STATS
+    return RenderStats::local(kStatNodeVisits) + RenderStats::local(kStatPrimTests);
+#else
+    return 0;
+#endif
+}
+
+// 时间戳计数器：x86 上用 rdtsc（不串行化，按像素计时足够准），其他平台退回 steady_clock 的计数
+inline uint64_t cycleCount() {
+#if defined(PT_HAS_RDTSC)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// 路径数就是相机射线数；恰好有 k 个顶点的路径数 = reached[k-1] - reached[k]
+inline uint64_t pathsWithVertices(const StatsSnapshot& s, uint64_t paths, int k) {
+    const uint64_t before = (k == 0) ? paths : s.reached[k - 1];
+    const uint64_t after = (k < kStatDepthBins) ? s.reached[k] : 0;
+    return before - after;
+}
+
+inline void printStatsSummary(std::ostream& os, const StatsSnapshot& s, const RayCounts& rays) {
+    const uint64_t paths = rays.n[kRayCamera];
+    const uint64_t total_rays = rays.total();
+    auto per = [](uint64_t a, uint64_t b) { return b ? static_cast<double>(a) / b : 0.0; };
+
+    os << "Stats: " << s.n[kStatNodeVisits] << " node visits (" << per(s.n[kStatNodeVisits], total_rays)
+       << " per ray), " << s.n[kStatPrimTests] << " primitive tests (" << per(s.n[kStatPrimTests], total_rays)
+       << " per ray)\n";
+    os << "  Paths: " << paths << ", avg vertices " << per(s.n[kStatVertices], paths)
+       << ", roulette terminations " << s.n[kStatRouletteKills] << "\n";
+    os << "  Light samples: " << s.n[kStatLightSamples] << ", rejected " << s.n[kStatLightRejected]
+       << ", shadow rays occluded " << s.n[kStatShadowOccluded] << " of " << rays.n[kRayShadow] << "\n";
+    os << "  Path vertices:";
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    for (int k = 0; k <= kStatDepthBins; ++k) {
+        const uint64_t count = pathsWithVertices(s, paths, k);
+        if (count == 0) continue;
+        os << " " << k << (k == kStatDepthBins ? "+" : "") << ":" << std::fixed << std::setprecision(1)
+           << 100.0 * per(count, paths) << "%";
+    }
+    os.flags(flags);
+    os.precision(precision);
+    os << "\n";
+}
+
+inline bool writeStatsJson(const std::string& path, const StatsSnapshot& s, const RayCounts& rays, double seconds) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    const uint64_t paths = rays.n[kRayCamera];
+    ofs << std::setprecision(9) << "{\n  \"seconds\": " << seconds << ",\n  \"rays\": {";
+    for (int t = 0; t < kRayTypeCount; ++t) {
+        ofs << (t ? ", " : "") << "\"" << rayTypeName(static_cast<RayType>(t)) << "\": " << rays.n[t];
+    }
+    ofs << "},\n  \"counters\": {";
+    for (int c = 0; c < kStatCounterCount; ++c) {
+        ofs << (c ? ", " : "") << "\"" << statCounterName(static_cast<StatCounter>(c)) << "\": " << s.n[c];
+    }
+    // path_vertices_histogram[k]：恰好 k 个顶点的路径数，最后一项是不少于 kStatDepthBins 个的
+    ofs << "},\n  \"path_vertices_histogram\": [";
+    for (int k = 0; k <= kStatDepthBins; ++k) {
+        ofs << (k ? ", " : "") << pathsWithVertices(s, paths, k);
+    }
+    ofs << "]\n}\n";
+    return static_cast<bool>(ofs);
+}
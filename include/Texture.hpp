@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "global.hpp"
+#include "ThreadPool.hpp"
+#include "stb_image.h"
+
+// sRGB 编码的 8 位分量 <-> 线性值
+inline float srgbToLinear(float c) {
+    return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float c) {
+    c = clamp01(c);
+    return (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// 贴图：按 RGBA8 sRGB 存储，取样时查表转成线性值；mip 链在线性空间里按盒式滤波逐层缩小得到
+// 每层按 4x4 的块存放，块内按 Morton 顺序，一块正好 64 字节（一条缓存行），
+// 双线性取样的 4 个纹素大多落在同一块里
+class Texture {
+public:
+    // rgba：width * height 个 RGBA8 纹素，第 0 行是图像最上面一行
+    Texture(int width, int height, const uint8_t* rgba) {
+        std::vector<Vector3f> linear(static_cast<size_t>(width) * height);
+        for (size_t p = 0; p < linear.size(); ++p) {
+            linear[p] = Vector3f(decode(rgba[4 * p + 0]), decode(rgba[4 * p + 1]), decode(rgba[4 * p + 2]));
+        }
+        addLevel(width, height, rgba);
+
+        // 每层宽高减半（向下取整，至少为 1），直到 1x1
+        int w = width, h = height;
+        std::vector<uint8_t> packed;
+        while (w > 1 || h > 1) {
+            const int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+            std::vector<Vector3f> next(static_cast<size_t>(nw) * nh);
+            packed.assign(next.size() * 4, 255);
+            for (int y = 0; y < nh; ++y) {
+                Tap ty = downsampleTap(h, nh, y);
+                for (int x = 0; x < nw; ++x) {
+                    Tap tx = downsampleTap(w, nw, x);
+                    Vector3f c(0.0f);
+                    for (int j = 0; j < 3; ++j) {
+                        for (int i = 0; i < 3; ++i) {
+                            c += linear[ty.index[j] * w + tx.index[i]] * (ty.weight[j] * tx.weight[i]);
+                        }
+                    }
+                    next[y * nw + x] = c;
+                    uint8_t* dst = &packed[4 * (static_cast<size_t>(y) * nw + x)];
+                    dst[0] = encode(c.x);
+                    dst[1] = encode(c.y);
+                    dst[2] = encode(c.z);
+                }
+            }
+            addLevel(nw, nh, packed.data());
+            linear.swap(next);
+            w = nw;
+            h = nh;
+        }
+    }
+
+    int width() const { return levels[0].width; }
+    int height() const { return levels[0].height; }
+    int levelCount() const { return static_cast<int>(levels.size()); }
+
+    // footprint：取样区域在 uv 空间里的宽度（见 Scene::setTextureFootprint），0 表示取最精细的一层
+    // 按 footprint 覆盖的纹素数选 mip 层，两层之间线性插值，层内双线性插值
+    Vector3f sample(float u, float v, float footprint) const {
+        float lod = 0.0f;
+        if (footprint > 0.0f) {
+            lod = std::log2(footprint * static_cast<float>(std::max(width(), height())));
+        }
+        const float max_lod = static_cast<float>(levelCount() - 1);
+        if (!(lod > 0.0f)) return bilinear(0, u, v);
+        if (lod >= max_lod) return bilinear(levelCount() - 1, u, v);
+        const int l0 = static_cast<int>(lod);
+        const float f = lod - static_cast<float>(l0);
+        return bilinear(l0, u, v) * (1.0f - f) + bilinear(l0 + 1, u, v) * f;
+    }
+
+private:
+    static constexpr int kTile = 4;
+
+    struct Level {
+        int width = 0, height = 0;
+        int tiles_x = 0;
+        std::vector<uint32_t> texels;  // RGBA8，按块存放
+
+        size_t index(int x, int y) const {
+            const size_t tile = static_cast<size_t>(y / kTile) * tiles_x + x / kTile;
+            return tile * kTile * kTile + morton2(x % kTile, y % kTile);
+        }
+    };
+
+    std::vector<Level> levels;
+
+    // 缩小一层时一个轴上的 3 个抽头
+    struct Tap {
+        int index[3];
+        float weight[3];
+    };
+
+    // 尺寸 n -> n / 2 时第 x 个纹素覆盖的区间 [x * n / half, (x + 1) * n / half)：
+    // 偶数尺寸正好是 2 个纹素；奇数尺寸 n = 2 * half + 1 跨 3 个纹素，按覆盖的长度加权，
+    // 这样每个纹素都被用到，上下两层在 uv 空间里也对齐；尺寸为 1 的轴不缩小
+    static Tap downsampleTap(int n, int half, int x) {
+        if (n == 1) return {{0, 0, 0}, {1.0f, 0.0f, 0.0f}};
+        if (n % 2 == 0) return {{2 * x, 2 * x + 1, 2 * x + 1}, {0.5f, 0.5f, 0.0f}};
+        const float inv = 1.0f / static_cast<float>(n);
+        return {{2 * x, 2 * x + 1, 2 * x + 2},
+                {static_cast<float>(half - x) * inv, static_cast<float>(half) * inv, static_cast<float>(x + 1) * inv}};
+    }
+
+    // 块内 2 位坐标交织成 4 位下标
+    static uint32_t morton2(int x, int y) {
+        return static_cast<uint32_t>((x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2));
+    }
+
+    static const float* lut() {
+        static const SrgbTable table;
+        return table.v;
+    }
+
+    struct SrgbTable {
+        float v[256];
+        SrgbTable() {
+            for (int i = 0; i < 256; ++i) v[i] = srgbToLinear(i / 255.0f);
+        }
+    };
+
+    static float decode(uint8_t c) { return lut()[c]; }
+    static uint8_t encode(float c) { return static_cast<uint8_t>(linearToSrgb(c) * 255.0f + 0.5f); }
+
+    void addLevel(int width, int height, const uint8_t* rgba) {
+        Level l;
+        l.width = width;
+        l.height = height;
+        l.tiles_x = (width + kTile - 1) / kTile;
+        const int tiles_y = (height + kTile - 1) / kTile;
+        l.texels.assign(static_cast<size_t>(l.tiles_x) * tiles_y * kTile * kTile, 0);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                uint32_t t;
+                std::memcpy(&t, rgba + 4 * (static_cast<size_t>(y) * width + x), 4);
+                l.texels[l.index(x, y)] = t;
+            }
+        }
+        levels.push_back(std::move(l));
+    }
+
+    // uv 的 v 向上，图像的行向下；纹素中心在 +0.5 处
+    Vector3f bilinear(int level, float u, float v) const {
+        const Level& l = levels[level];
+        const float x = (u - std::floor(u)) * l.width - 0.5f;
+        const float y = (1.0f - (v - std::floor(v))) * l.height - 0.5f;
+        const float fx = std::floor(x), fy = std::floor(y);
+        const int x0 = static_cast<int>(fx), y0 = static_cast<int>(fy);
+        const float tx = x - fx, ty = y - fy;
+        // 环绕只算一次：x0/y0 落在 [-1, size) 里
+        const int xa = (x0 < 0) ? l.width - 1 : x0, xb = (x0 + 1 >= l.width) ? 0 : x0 + 1;
+        const int ya = (y0 < 0) ? l.height - 1 : y0, yb = (y0 + 1 >= l.height) ? 0 : y0 + 1;
+        return (fetch(l, xa, ya) * (1.0f - tx) + fetch(l, xb, ya) * tx) * (1.0f - ty) +
+               (fetch(l, xa, yb) * (1.0f - tx) + fetch(l, xb, yb) * tx) * ty;
+    }
+
+    static Vector3f fetch(const Level& l, int x, int y) {
+        const uint8_t* c = reinterpret_cast<const uint8_t*>(&l.texels[l.index(x, y)]);
+        const float* table = lut();
+        return Vector3f(table[c[0]], table[c[1]], table[c[2]]);
+    }
+};
+
+// 进程内共享的贴图缓存：同一路径只解码一次，各材质共享同一个 Texture
+// 解码（含建 mip 链）可以交给线程池，和建三角形、建 BVH 同时进行；结果用 shared_future 取
+class TextureManager {
+public:
+    using Handle = std::shared_future<std::shared_ptr<const Texture>>;
+
+    static TextureManager& instance() {
+        static TextureManager manager;
+        return manager;
+    }
+
+    // 提交解码任务后立即返回；pool 为空时在当前线程解码完再返回
+    // 同一路径第二次请求拿到同一个 Handle。Handle::get() 会阻塞，不要在 pool 的任务里等
+    Handle loadAsync(const std::string& path, ThreadPool* pool) {
+        std::shared_ptr<std::promise<std::shared_ptr<const Texture>>> promise;
+        Handle handle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(path);
+            if (it != cache.end()) return it->second;
+            promise = std::make_shared<std::promise<std::shared_ptr<const Texture>>>();
+            handle = promise->get_future().share();
+            cache[path] = handle;
+        }
+        if (pool) {
+            pool->submit(decode_group, [promise, path](int) { promise->set_value(decode(path)); });
+        } else {
+            promise->set_value(decode(path));
+        }
+        return handle;
+    }
+
+    // 同步加载；解码失败返回空指针（失败也会记下来，不会反复尝试）
+    std::shared_ptr<const Texture> load(const std::string& path) {
+        return loadAsync(path, nullptr).get();
+    }
+
+    // 已经请求过的贴图个数（含失败的和还在解码的）
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cache.size();
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Handle> cache;
+    TaskGroup decode_group;  // 只用来挂任务，等待走各自的 Handle
+
+    static std::shared_ptr<const Texture> decode(const std::string& path) {
+        std::shared_ptr<const Texture> texture;
+        int width = 0, height = 0, channels = 0;
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+        if (data && width > 0 && height > 0) {
+            texture = std::make_shared<Texture>(width, height, data);
+        } else {
+            std::cerr << "Failed to load texture: " << path << std::endl;
+        }
+        if (data) stbi_image_free(data);
+        return texture;
+    }
+};
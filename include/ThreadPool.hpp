@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 一组任务的完成计数，用于等待某一批任务而不是整个线程池
+class TaskGroup {
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+    std::atomic<int> pending{0};
+};
+
+// 可复用的 work-stealing 线程池
+// 每个 worker 有自己的双端队列：自己从尾部取（LIFO，缓存友好），空了就从别人头部偷（FIFO）
+class ThreadPool {
+public:
+    using Task = std::function<void(int /*worker*/)>;
+
+    struct WorkerStats {
+        double busy_seconds = 0.0;
+        double idle_seconds = 0.0;
+        uint64_t tasks = 0;
+        uint64_t steals = 0;
+    };
+
+    explicit ThreadPool(int num_threads) {
+        if (num_threads <= 0) num_threads = 1;
+        queues.reserve(num_threads);
+        counters.reserve(num_threads);
+        for (int i = 0; i < num_threads; ++i) {
+            queues.emplace_back(new WorkerQueue());
+            counters.emplace_back(new WorkerCounters());
+        }
+        stats_start = Clock::now();
+        workers.reserve(num_threads);
+        for (int i = 0; i < num_threads; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_cv.notify_all();
+        for (auto& th : workers) {
+            if (th.joinable()) th.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    // 提交任务：在 worker 线程里提交就放进自己的队列，否则轮流分给各个 worker
+    void submit(TaskGroup& group, Task task) {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        int target = current_worker;
+        if (target < 0 || owner != this) {
+            target = static_cast<int>(next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+        }
+        // 先加计数再入队：计数偏大只会让 worker 多转一圈，偏小则可能睡过头
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back({std::move(task), &group});
+        }
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        sleep_cv.notify_one();
+    }
+
+    // 等待 group 中的任务全部完成
+    // worker 线程里调用时会顺便执行队列里的任务（嵌套并行不会死锁）
+    void wait(TaskGroup& group) {
+        if (owner == this && current_worker >= 0) {
+            while (!group.done()) {
+                if (!runOne(current_worker)) {
+                    std::this_thread::yield();
+                }
+            }
+            return;
+        }
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cv.wait(lock, [&] { return group.done(); });
+    }
+
+    // 非 worker 线程限时等待（用于边等边打印进度），完成返回 true
+    template <typename Rep, typename Period>
+    bool waitFor(TaskGroup& group, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        return done_cv.wait_for(lock, timeout, [&] { return group.done(); });
+    }
+
+    // 并行执行 fn(i, worker)，i ∈ [0, count)，每 grain 个下标一个任务
+    template <typename F>
+    void parallelFor(int count, int grain, F&& fn) {
+        if (count <= 0) return;
+        if (grain < 1) grain = 1;
+        TaskGroup group;
+        for (int begin = 0; begin < count; begin += grain) {
+            int end = std::min(count, begin + grain);
+            submit(group, [&fn, begin, end](int worker) {
+                for (int i = begin; i < end; ++i) fn(i, worker);
+            });
+        }
+        wait(group);
+    }
+
+    // 统计区间从上一次 resetStats 开始
+    void resetStats() {
+        for (auto& c : counters) {
+            c->busy_ns.store(0, std::memory_order_relaxed);
+            c->tasks.store(0, std::memory_order_relaxed);
+            c->steals.store(0, std::memory_order_relaxed);
+        }
+        stats_start = Clock::now();
+    }
+
+    std::vector<WorkerStats> stats() const {
+        double wall = std::chrono::duration<double>(Clock::now() - stats_start).count();
+        std::vector<WorkerStats> out(counters.size());
+        for (size_t i = 0; i < counters.size(); ++i) {
+            out[i].busy_seconds = counters[i]->busy_ns.load(std::memory_order_relaxed) * 1e-9;
+            out[i].idle_seconds = std::max(0.0, wall - out[i].busy_seconds);
+            out[i].tasks = counters[i]->tasks.load(std::memory_order_relaxed);
+            out[i].steals = counters[i]->steals.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    // 当前线程在本线程池中的编号，不是 worker 时返回 -1
+    int workerIndex() const {
+        return owner == this ? current_worker : -1;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        Task task;
+        TaskGroup* group;
+    };
+
+    // 每个 worker 单独分配，避免互相伪共享
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Entry> tasks;
+    };
+
+    struct alignas(64) WorkerCounters {
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::unique_ptr<WorkerCounters>> counters;
+
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> next_queue{0};
+    bool stopping = false;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    Clock::time_point stats_start;
+
+    static thread_local int current_worker;
+    static thread_local const ThreadPool* owner;
+    static thread_local int run_depth;
+
+    bool popOwn(int w, Entry& out) {
+        WorkerQueue& q = *queues[w];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int w, Entry& out) {
+        int n = static_cast<int>(queues.size());
+        for (int k = 1; k < n; ++k) {
+            WorkerQueue& q = *queues[(w + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(int w) {
+        Entry e;
+        bool stolen = false;
+        if (!popOwn(w, e)) {
+            if (!steal(w, e)) return false;
+            stolen = true;
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        // 嵌套 wait 里执行的任务已经算在外层任务的时间里了，只统计最外层
+        bool outermost = (run_depth++ == 0);
+        auto t0 = Clock::now();
+        e.task(w);
+        auto t1 = Clock::now();
+        --run_depth;
+
+        WorkerCounters& c = *counters[w];
+        if (outermost) {
+            c.busy_ns.fetch_add(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()),
+                std::memory_order_relaxed);
+        }
+        c.tasks.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) c.steals.fetch_add(1, std::memory_order_relaxed);
+
+        if (e.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            // 加锁再通知，避免等待方错过唤醒
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done_cv.notify_all();
+        }
+        return true;
+    }
+
+    void workerLoop(int w) {
+        current_worker = w;
+        owner = this;
+        while (true) {
+            if (runOne(w)) continue;
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleep_cv.wait(lock, [&] {
+                return stopping || queued.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+};
+
+inline thread_local int ThreadPool::current_worker = -1;
+inline thread_local const ThreadPool* ThreadPool::owner = nullptr;
+inline thread_local int ThreadPool::run_depth = 0;
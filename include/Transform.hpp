@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cmath>
+#include "global.hpp"
+#include "AABB.hpp"
+
+// 仿射变换：3x4 矩阵（左 3x3 为线性部分，最后一列为平移），同时存着逆变换
+// 只提供平移、缩放、旋转和它们的组合，逆矩阵跟着一起算出来，不需要通用求逆
+struct Transform {
+    float m[3][4];
+    float inv[3][4];
+
+    // 默认是单位变换
+    Transform() {
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                m[r][c] = inv[r][c] = (r == c) ? 1.0f : 0.0f;
+            }
+        }
+    }
+
+    static Transform translate(const Vector3f& t) {
+        Transform x;
+        const float d[3] = {t.x, t.y, t.z};
+        for (int r = 0; r < 3; ++r) {
+            x.m[r][3] = d[r];
+            x.inv[r][3] = -d[r];
+        }
+        return x;
+    }
+
+    static Transform scale(const Vector3f& s) {
+        Transform x;
+        const float d[3] = {s.x, s.y, s.z};
+        for (int r = 0; r < 3; ++r) {
+            x.m[r][r] = d[r];
+            x.inv[r][r] = 1.0f / d[r];
+        }
+        return x;
+    }
+
+    // 绕过原点的 axis 轴旋转 degrees 度（右手系）；旋转矩阵的逆就是转置
+    static Transform rotate(const Vector3f& axis, float degrees) {
+        Vector3f a = axis.normalized();
+        float rad = degrees * PI / 180.0f;
+        float s = std::sin(rad), c = std::cos(rad), k = 1.0f - c;
+        const float r[3][3] = {
+            {a.x * a.x * k + c,       a.x * a.y * k - a.z * s, a.x * a.z * k + a.y * s},
+            {a.y * a.x * k + a.z * s, a.y * a.y * k + c,       a.y * a.z * k - a.x * s},
+            {a.z * a.x * k - a.y * s, a.z * a.y * k + a.x * s, a.z * a.z * k + c}
+        };
+        Transform x;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                x.m[i][j] = r[i][j];
+                x.inv[i][j] = r[j][i];
+            }
+        }
+        return x;
+    }
+
+    // (*this) * o：先做 o 再做 *this
+    Transform operator * (const Transform& o) const {
+        Transform x;
+        compose(m, o.m, x.m);
+        compose(o.inv, inv, x.inv);
+        return x;
+    }
+
+    Transform inverse() const {
+        Transform x;
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                x.m[r][c] = inv[r][c];
+                x.inv[r][c] = m[r][c];
+            }
+        }
+        return x;
+    }
+
+    Vector3f point(const Vector3f& p) const { return applyPoint(m, p); }
+    Vector3f vector(const Vector3f& v) const { return applyVector(m, v); }
+    Vector3f inversePoint(const Vector3f& p) const { return applyPoint(inv, p); }
+    Vector3f inverseVector(const Vector3f& v) const { return applyVector(inv, v); }
+
+    // 线性部分的行列式：体积的缩放比例
+    float determinant() const {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+               m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    // 法线用逆矩阵的转置变换，结果未归一化
+    Vector3f normal(const Vector3f& n) const {
+        return Vector3f(inv[0][0] * n.x + inv[1][0] * n.y + inv[2][0] * n.z,
+                        inv[0][1] * n.x + inv[1][1] * n.y + inv[2][1] * n.z,
+                        inv[0][2] * n.x + inv[1][2] * n.y + inv[2][2] * n.z);
+    }
+
+    // 变换后的 8 个角点的包围盒
+    AABB bounds(const AABB& b) const {
+        AABB out;
+        if (!b.valid()) return out;
+        for (int i = 0; i < 8; ++i) {
+            Vector3f corner((i & 1) ? b.max_p.x : b.min_p.x,
+                            (i & 2) ? b.max_p.y : b.min_p.y,
+                            (i & 4) ? b.max_p.z : b.min_p.z);
+            out.expand(point(corner));
+        }
+        return out;
+    }
+
+private:
+    static Vector3f applyPoint(const float a[3][4], const Vector3f& p) {
+        return Vector3f(a[0][0] * p.x + a[0][1] * p.y + a[0][2] * p.z + a[0][3],
+                        a[1][0] * p.x + a[1][1] * p.y + a[1][2] * p.z + a[1][3],
+                        a[2][0] * p.x + a[2][1] * p.y + a[2][2] * p.z + a[2][3]);
+    }
+
+    static Vector3f applyVector(const float a[3][4], const Vector3f& v) {
+        return Vector3f(a[0][0] * v.x + a[0][1] * v.y + a[0][2] * v.z,
+                        a[1][0] * v.x + a[1][1] * v.y + a[1][2] * v.z,
+                        a[2][0] * v.x + a[2][1] * v.y + a[2][2] * v.z);
+    }
+
+    // out = a * b（把 3x4 看作最后一行为 0 0 0 1 的 4x4）
+    static void compose(const float a[3][4], const float b[3][4], float out[3][4]) {
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                float v = (c == 3) ? a[r][3] : 0.0f;
+                for (int k = 0; k < 3; ++k) v += a[r][k] * b[k][c];
+                out[r][c] = v;
+            }
+        }
+    }
+};
@@ -111,10 +111,83 @@
 #pragma once
 
 #include "Object.hpp"
+#include "AABB.hpp"
 
 // 前向声明 Material
 class Material;
 
+// Möller–Trumbore：只做相交判断，命中 [EPS, t_max) 时输出 t 和重心坐标 (u, v)
+// edge1 = v1 - v0, edge2 = v2 - v0
+inline bool intersectTriangle(const Ray& ray, const Vector3f& v0,
+                              const Vector3f& edge1, const Vector3f& edge2,
+                              float t_max, float& t, float& u, float& v) {
+    const float EPS = 1e-6f;
+
+    Vector3f pvec = cross(ray.direction, edge2);
+    float det = dot(edge1, pvec);
+
+    if (std::fabs(det) < EPS) {
+        return false;
+    }
+
+    float invDet = 1.0f / det;
+
+    Vector3f tvec = ray.origin - v0;
+    u = dot(tvec, pvec) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+
+    Vector3f qvec = cross(tvec, edge1);
+    v = dot(ray.direction, qvec) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+
+    t = dot(edge2, qvec) * invDet;
+    return t >= EPS && t < t_max;
+}
+
+// 一个三角形对光线包做 Möller–Trumbore，运算顺序与 intersectTriangle 相同，结果逐条一致
+// 返回 packet.active 中在 [EPS, t_max) 内命中的射线掩码
+inline uint32_t intersectTrianglePacket(const RayPacket& packet, const Vector3f& v0,
+                                        const Vector3f& edge1, const Vector3f& edge2,
+                                        RayPacket::vfloat& t, RayPacket::vfloat& u,
+                                        RayPacket::vfloat& v) {
+    using vfloat = RayPacket::vfloat;
+    const vfloat eps = vfloat::broadcast(1e-6f);
+    const vfloat zero = vfloat::broadcast(0.0f);
+    const vfloat one = vfloat::broadcast(1.0f);
+
+    const vfloat e1x = vfloat::broadcast(edge1.x), e1y = vfloat::broadcast(edge1.y), e1z = vfloat::broadcast(edge1.z);
+    const vfloat e2x = vfloat::broadcast(edge2.x), e2y = vfloat::broadcast(edge2.y), e2z = vfloat::broadcast(edge2.z);
+    const vfloat dx = vfloat::load(packet.dir[0]), dy = vfloat::load(packet.dir[1]), dz = vfloat::load(packet.dir[2]);
+
+    // pvec = cross(dir, edge2)
+    vfloat px = dy * e2z - dz * e2y;
+    vfloat py = dz * e2x - dx * e2z;
+    vfloat pz = dx * e2y - dy * e2x;
+    vfloat det = e1x * px + e1y * py + e1z * pz;
+    vfloat inv_det = one / det;
+
+    vfloat tx = vfloat::load(packet.org[0]) - vfloat::broadcast(v0.x);
+    vfloat ty = vfloat::load(packet.org[1]) - vfloat::broadcast(v0.y);
+    vfloat tz = vfloat::load(packet.org[2]) - vfloat::broadcast(v0.z);
+    u = (tx * px + ty * py + tz * pz) * inv_det;
+
+    // qvec = cross(tvec, edge1)
+    vfloat qx = ty * e1z - tz * e1y;
+    vfloat qy = tz * e1x - tx * e1z;
+    vfloat qz = tx * e1y - ty * e1x;
+    v = (dx * qx + dy * qy + dz * qz) * inv_det;
+    t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+    simd::vmask<RayPacket::kSize> m =
+        (simd::abs(det) >= eps) & (u >= zero) & (u <= one) & (v >= zero) &
+        ((u + v) <= one) & (t >= eps) & (t < vfloat::load(packet.t_max));
+    return m.bits() & packet.active;
+}
+
 class Triangle : public Object {
 public:
     Triangle(
@@ -149,41 +222,19 @@ public:
     }
 
     bool intersect(const Ray& ray, HitRecord& rec) const override {
-        const float EPS = 1e-6f;
-
         Vector3f edge1 = v1 - v0;
         Vector3f edge2 = v2 - v0;
 
-        Vector3f pvec = cross(ray.direction, edge2);
-        float det = dot(edge1, pvec);
-
-        if (std::fabs(det) < EPS) {
-            return false;
-        }
-
-        float invDet = 1.0f / det;
-
-        Vector3f tvec = ray.origin - v0;
-        float u = dot(tvec, pvec) * invDet;
-        if (u < 0.0f || u > 1.0f) {
-            return false;
-        }
-
-        Vector3f qvec = cross(tvec, edge1);
-        float v = dot(ray.direction, qvec) * invDet;
-        if (v < 0.0f || u + v > 1.0f) {
-            return false;
-        }
-
-        float t = dot(edge2, qvec) * invDet;
-        if (t < EPS || t >= rec.t) {
+        float t, u, v;
+        if (!intersectTriangle(ray, v0, edge1, edge2, rec.t, t, u, v)) {
             return false;
         }
 
         rec.t = t;
         rec.p = ray.at(t);
 
-        Vector3f outward_normal = cross(edge1, edge2).normalized();
+        Vector3f face_normal = cross(edge1, edge2);
+        Vector3f outward_normal = face_normal.normalized();
         rec.set_face_normal(ray, outward_normal);
 
         if (has_uv) {
@@ -192,14 +243,23 @@ public:
                 w * uv0.x + u * uv1.x + v * uv2.x,
                 w * uv0.y + u * uv1.y + v * uv2.y
             );
+            float uv_area = std::fabs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y));
+            float area = face_normal.length();
+            rec.uv_density = (area > 0.0f) ? std::sqrt(uv_area / area) : 0.0f;
         } else {
             rec.uv = Vector2f(0.0f, 0.0f);
+            rec.uv_density = 0.0f;
         }
 
         rec.material = material;
         return true;
     }
 
+    bool occluded(const Ray& ray, float t_max) const override {
+        float t, u, v;
+        return intersectTriangle(ray, v0, v1 - v0, v2 - v0, t_max, t, u, v);
+    }
+
     // --- 新增的一些 getter，用于 Mesh / Light 采样 ---
     const Vector3f& getV0() const { return v0; }
     const Vector3f& getV1() const { return v1; }
@@ -208,6 +268,14 @@ public:
 
     float area() const { return m_area; }
 
+    AABB bounds() const override {
+        AABB b;
+        b.expand(v0);
+        b.expand(v1);
+        b.expand(v2);
+        return b;
+    }
+
 private:
     Vector3f v0, v1, v2;
     Vector2f uv0, uv1, uv2;
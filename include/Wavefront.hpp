@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "global.hpp"
+#include "HitRecord.hpp"
+#include "Material.hpp"
+#include "RayPacket.hpp"
+#include "Sampler.hpp"
+#include "Scene.hpp"
+
+// Wavefront 形式的 MIS 路径追踪：
+// 一批路径的状态按字段分开存放（SoA），每次弹射分成几个阶段对整批路径依次执行，
+// 而不是一条路径从求交一路递归到底：
+//   extend   所有活跃路径（8 条一包）求交；未命中、打到光源、到达最大深度的路径在这里结束
+//   sort     待着色的路径按材质排序，同一材质的路径连在一起着色
+//   light    光源采样，算好贡献的阴影射线写进阴影队列
+//   scatter  BSDF 采样生成下一段射线，再做俄罗斯轮盘
+//   connect  阴影射线 8 条一包测试，可见的把贡献加到各自的路径上
+//   compact  去掉已经结束的路径
+// 估计量、采样维度与 Scene::castRayMIS 完全相同，所以得到同样的图像
+class WavefrontIntegrator {
+public:
+    // record_aov 为真时记下每条路径第一个交点的 AOV（见 pathAov）
+    WavefrontIntegrator(const Scene& scene, int max_depth, int rr_depth, bool record_aov = false)
+        : scene(scene), max_depth(max_depth), rr_depth(rr_depth), record_aov(record_aov) {}
+
+    void clear() {
+        pixel.clear();
+        sample.clear();
+        origin.clear();
+        direction.clear();
+        throughput.clear();
+        radiance.clear();
+        prev_bsdf_pdf.clear();
+        path_length.clear();
+        aovs.clear();
+    }
+
+    // 加入一条以相机射线 ray 开始的路径，返回它的编号
+    uint32_t addPath(uint32_t pixel_index, uint32_t sample_index, const Ray& ray) {
+        pixel.push_back(pixel_index);
+        sample.push_back(sample_index);
+        origin.push_back(ray.origin);
+        direction.push_back(ray.direction);
+        throughput.push_back(Vector3f(1.0f));
+        radiance.push_back(Vector3f(0.0f));
+        prev_bsdf_pdf.push_back(0.0f);
+        path_length.push_back(0.0f);
+        if (record_aov) aovs.emplace_back();
+        return static_cast<uint32_t>(pixel.size() - 1);
+    }
+
+    // 把已加入的路径全部追踪完，结果见 pathRadiance
+    void run(Sampler& sampler) {
+        const uint32_t n = static_cast<uint32_t>(pixel.size());
+        hits.resize(n);
+        materials.resize(n);
+        kind.resize(n);
+        alive.assign(n, 0);
+        active.resize(n);
+        for (uint32_t i = 0; i < n; ++i) active[i] = i;
+
+        for (int bounce = 0; !active.empty(); ++bounce) {
+            extend(bounce);
+            sortByMaterial();
+            sampleLights(bounce, sampler);
+            scatter(bounce, sampler);
+            connect();
+            compact();
+        }
+    }
+
+    size_t size() const { return pixel.size(); }
+
+    const Vector3f& pathRadiance(uint32_t path) const { return radiance[path]; }
+
+    // 只有 record_aov 时可用
+    const Scene::Aov& pathAov(uint32_t path) const { return aovs[path]; }
+
+private:
+    const Scene& scene;
+    int max_depth;
+    int rr_depth;
+    bool record_aov;
+
+    // 每条路径的状态，下标是路径编号
+    std::vector<uint32_t> pixel;
+    std::vector<uint32_t> sample;
+    std::vector<Vector3f> origin;
+    std::vector<Vector3f> direction;
+    std::vector<Vector3f> throughput;
+    std::vector<Vector3f> radiance;
+    std::vector<float> prev_bsdf_pdf;  // 上一次 BSDF 采样的方向 pdf，0 表示相机射线
+    std::vector<float> path_length;    // 从相机到当前顶点的路径长度，射线锥用
+    std::vector<Scene::Aov> aovs;      // 第一个交点的 AOV（record_aov 时）
+    std::vector<HitRecord> hits;       // 当前这次弹射的交点
+    std::vector<Material*> materials;  // 交点材质（没有材质时为默认灰）
+    std::vector<uint8_t> alive;        // scatter 之后是否还要继续弹射
+
+    // 各阶段之间传递的队列
+    std::vector<uint32_t> active;      // 本次弹射要求交的路径，按编号升序
+    std::vector<uint32_t> shade_queue; // 命中非光源表面、需要着色的路径
+    std::vector<uint32_t> sorted_queue;
+    std::vector<const Material*> kinds; // 本次弹射出现的材质
+    std::vector<uint32_t> kind;         // 每条路径交点材质在 kinds 里的下标
+
+    struct ShadowItem {
+        Ray ray;
+        float t_max;
+        uint32_t path;
+        Vector3f contribution;  // 可见时加到 radiance 上的值
+    };
+    std::vector<ShadowItem> shadow_queue;
+
+    // 活跃路径每 8 条打成一个光线包求交；相机射线按像素、样本序号排列，同一像素的样本方向几乎相同，
+    // 之后的弹射方向分散，由 Scene::intersectPacket 的一致性检查退回逐条求交
+    void extend(int bounce) {
+        shade_queue.clear();
+        const size_t n = active.size();
+        RayCounters::add(bounce == 0 ? kRayCamera : kRayBounce, n);
+        for (size_t first = 0; first < n; first += RayPacket::kSize) {
+            const int count = static_cast<int>(std::min<size_t>(RayPacket::kSize, n - first));
+            RayPacket packet;
+            HitRecord recs[RayPacket::kSize];
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                packet.clearLane(lane);
+                if (lane < count) {
+                    const uint32_t path = active[first + lane];
+                    packet.set(lane, Ray(origin[path], direction[path]), std::numeric_limits<float>::max());
+                }
+            }
+            const uint32_t hit = scene.intersectPacket(packet, recs);
+            for (int lane = 0; lane < count; ++lane) {
+                const uint32_t path = active[first + lane];
+                hits[path] = recs[lane];
+                classifyHit(path, bounce, (hit >> lane) & 1u);
+            }
+        }
+    }
+
+    // 一次求交的结果：未命中、打到光源、到达最大深度的路径结束，其余进入着色队列
+    void classifyHit(uint32_t path, int bounce, bool hit) {
+        alive[path] = 0;
+        if (!hit) return;
+        PT_STAT_VERTEX(bounce);
+
+        path_length[path] += hits[path].t;
+        scene.setTextureFootprint(hits[path], direction[path], path_length[path]);
+        const HitRecord& rec = hits[path];
+        if (record_aov && bounce == 0) Scene::fillAov(rec, aovs[path]);
+        Material* mat = rec.material ? rec.material : Scene::default_gray();
+        materials[path] = mat;
+
+        // BSDF 采样打到光源：按 BSDF pdf 与光源 pdf（换算到立体角）加权
+        if (mat->isEmissive()) {
+            if (rec.front_face || mat->m_two_sided) {
+                float w = 1.0f;
+                if (prev_bsdf_pdf[path] > 0.0f) {
+                    float cos_light = std::fabs(dot(rec.N, direction[path]));
+                    float pdf_light = (cos_light > 0.0f)
+                        ? scene.lightAreaPdf() * rec.t * rec.t / cos_light : 0.0f;
+                    w = Scene::powerHeuristic(prev_bsdf_pdf[path], pdf_light);
+                }
+                radiance[path] += throughput[path] * mat->emission() * w;
+            }
+            return;
+        }
+        if (bounce == max_depth) return;
+
+        shade_queue.push_back(path);
+    }
+
+    // 按材质类型、再按材质对象排序，同一材质的着色代码和纹理连续访问
+    // 一批里出现的材质很少，所以先给材质编号再计数排序，同一材质内保持路径编号的顺序；
+    // 每条路径的结果只取决于它自己的状态和采样维度，所以着色顺序不影响图像
+    void sortByMaterial() {
+        kinds.clear();
+        const Material* last = nullptr;
+        uint32_t last_kind = 0;
+        for (uint32_t path : shade_queue) {
+            const Material* mat = materials[path];
+            if (mat != last) {
+                last = mat;
+                last_kind = static_cast<uint32_t>(
+                    std::find(kinds.begin(), kinds.end(), mat) - kinds.begin());
+                if (last_kind == kinds.size()) kinds.push_back(mat);
+            }
+            kind[path] = last_kind;
+        }
+        if (kinds.size() < 2) return;
+
+        std::vector<uint32_t> order(kinds.size());
+        for (uint32_t k = 0; k < order.size(); ++k) order[k] = k;
+        std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+            const Material* ma = kinds[a];
+            const Material* mb = kinds[b];
+            if (ma->m_type != mb->m_type) return ma->m_type < mb->m_type;
+            return std::less<const Material*>()(ma, mb);
+        });
+        std::vector<uint32_t> start(kinds.size() + 1, 0);
+        for (uint32_t path : shade_queue) ++start[kind[path] + 1];
+        std::vector<uint32_t> offset(kinds.size());
+        uint32_t sum = 0;
+        for (uint32_t k : order) {
+            offset[k] = sum;
+            sum += start[k + 1];
+        }
+        sorted_queue.resize(shade_queue.size());
+        for (uint32_t path : shade_queue) sorted_queue[offset[kind[path]]++] = path;
+        shade_queue.swap(sorted_queue);
+    }
+
+    void sampleLights(int bounce, Sampler& sampler) {
+        shadow_queue.clear();
+        const uint32_t dim = SampleDims::bounce(bounce);
+        for (uint32_t path : shade_queue) {
+            const HitRecord& rec = hits[path];
+            const Material* mat = materials[path];
+            const Vector3f& N = rec.N;
+            const Vector3f wo = -direction[path];
+
+            sampler.startPixelSample(pixel[path], sample[path]);
+            sampler.setDimension(dim + SampleDims::kLightSelect);
+            Scene::LightSample ls;
+            if (!scene.sampleLight(ls, sampler)) continue;
+
+            Scene::ShadowRay sr = Scene::makeShadowRay(rec, ls);
+            const Vector3f& light_dir = sr.ray.direction;
+            float cos_theta = dot(N, light_dir);
+            float cos_light = dot(ls.normal, -light_dir);
+            if (ls.two_sided) cos_light = std::fabs(cos_light);
+            if (cos_theta <= 0.0f || cos_light <= 0.0f || ls.pdf <= 0.0f) {
+                PT_STAT_ADD(kStatLightRejected, 1);
+                continue;
+            }
+
+            float pdf_light = ls.pdf * sr.dist2 / cos_light;
+            float pdf_bsdf = mat->pdf(light_dir, wo, N);
+            float w = Scene::powerHeuristic(pdf_light, pdf_bsdf);
+            Vector3f f_r = mat->eval(light_dir, wo, N, rec.uv, rec.uv_footprint);
+
+            ShadowItem item;
+            item.ray = sr.ray;
+            item.t_max = sr.dist - EPSILON;
+            item.path = path;
+            item.contribution = throughput[path] * ls.emission * f_r * (cos_theta * w / pdf_light);
+            shadow_queue.push_back(item);
+        }
+    }
+
+    void scatter(int bounce, Sampler& sampler) {
+        const uint32_t dim = SampleDims::bounce(bounce);
+        for (uint32_t path : shade_queue) {
+            const HitRecord& rec = hits[path];
+            const Material* mat = materials[path];
+            const Vector3f& N = rec.N;
+            const Vector3f wo = -direction[path];
+
+            sampler.startPixelSample(pixel[path], sample[path]);
+            float pdf = 0.0f;
+            sampler.setDimension(dim + SampleDims::kBsdfLobe);
+            Vector3f wi = mat->sample(N, wo, pdf, sampler);
+            if (pdf <= 0.0f) continue;
+            float cos_theta = dot(N, wi);
+            if (cos_theta <= 0.0f) continue;
+
+            Vector3f f_r = mat->eval(wi, wo, N, rec.uv, rec.uv_footprint);
+            throughput[path] = throughput[path] * f_r * (cos_theta / pdf);
+            if (!Scene::russianRoulette(throughput[path], bounce, rr_depth, dim, sampler)) continue;
+            prev_bsdf_pdf[path] = pdf;
+            origin[path] = rec.p + N * EPSILON;
+            direction[path] = wi;
+            alive[path] = 1;
+        }
+    }
+
+    // 光源贡献在下一次 extend 之前加上，每条路径上的累加顺序与 castRayMIS 一致
+    // 阴影射线同样每 8 条一包
+    void connect() {
+        const size_t n = shadow_queue.size();
+        RayCounters::add(kRayShadow, n);
+        for (size_t first = 0; first < n; first += RayPacket::kSize) {
+            const int count = static_cast<int>(std::min<size_t>(RayPacket::kSize, n - first));
+            RayPacket packet;
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                packet.clearLane(lane);
+                if (lane < count) {
+                    const ShadowItem& item = shadow_queue[first + lane];
+                    packet.set(lane, item.ray, item.t_max);
+                }
+            }
+            const uint32_t blocked = scene.occludedPacket(packet);
+            PT_STAT_ADD(kStatShadowOccluded, simd::popcount(blocked));
+            for (int lane = 0; lane < count; ++lane) {
+                const ShadowItem& item = shadow_queue[first + lane];
+                if (!(blocked & (1u << lane))) {
+                    radiance[item.path] += item.contribution;
+                }
+            }
+        }
+    }
+
+    void compact() {
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [this](uint32_t path) { return !alive[path]; }),
+                     active.end());
+    }
+};
@@ -0,0 +1,523 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "BVH.hpp"
+#include "HitRecord.hpp"
+#include "SIMD.hpp"
+#include "RayPacket.hpp"
+#include "Triangle.hpp"
+
+// 由二叉 BVH 折叠出来的 N 叉 BVH（N = 4 或 8），专门给三角形网格用
+// 节点里 N 个孩子的包围盒按 SoA 存放，一次 SIMD 运算测完所有孩子；
+// 叶子里的三角形按 N 个一组打包成 SoA 块（v0 + 两条边），一组一起做 Möller–Trumbore
+template <int N>
+class WideBVH {
+public:
+    static constexpr int kWidth = N;
+    static constexpr uint32_t kInvalid = 0xffffffffu;
+    // 二叉 BVH 深度不超过 64，每层最多压入 N - 1 个兄弟
+    static constexpr int kStackSize = 64 * N;
+
+    // bounds[2 * axis + 0] 是该轴的 min，bounds[2 * axis + 1] 是 max；空槽为空盒，永远测不中
+    struct alignas(32) Node {
+        float bounds[6][N];
+        uint32_t child[N];  // 内部孩子：节点下标；叶子：第一个三角形块的下标
+        uint32_t count[N];  // 0 表示内部孩子，否则是叶子的三角形块数
+    };
+
+    // 空位的边为 0，行列式为 0，不会被判为命中
+    struct alignas(32) TriangleBlock {
+        float v0[3][N];
+        float e1[3][N];
+        float e2[3][N];
+        uint32_t prim[N];
+    };
+
+    // getTriangle(prim, v0, v1, v2) 取出图元的三个顶点
+    template <typename TriFn>
+    void build(const BVH& bvh, TriFn&& getTriangle) {
+        nodes = Buffer<Node>();
+        blocks = Buffer<TriangleBlock>();
+        if (bvh.empty()) return;
+
+        const Buffer<BVHNode>& bin = bvh.getNodes();
+
+        // 每棵子树的图元数；深度优先存放，孩子的下标总比父节点大，倒着扫一遍即可
+        std::vector<uint32_t> subtree(bin.size());
+        for (size_t i = bin.size(); i-- > 0;) {
+            subtree[i] = bin[i].isLeaf() ? bin[i].count
+                                         : subtree[i + 1] + subtree[bin[i].offset];
+        }
+
+        BuildOutput out;
+        out.nodes.reserve(bin.size() / 2 + 1);
+        out.blocks.reserve(bvh.primIndices().size() / N + bin.size() / 2 + 1);
+        collapse(out, bvh, subtree, 0, getTriangle);
+        nodes = std::move(out.nodes);
+        blocks = std::move(out.blocks);
+    }
+
+    // 最近交点：命中的孩子按进入距离排序压栈，近的先出；hit.t 作为当前最远距离
+    bool intersect(const Ray& ray, PrimitiveHit& hit) const {
+        if (nodes.empty()) return false;
+
+        RayData r(ray);
+        StackEntry stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = {0, 0, 0.0f};
+
+        bool found = false;
+        while (sp > 0) {
+            const StackEntry e = stack[--sp];
+            if (e.t_near >= hit.t) continue;
+
+            PT_STAT_ADD(kStatNodeVisits, 1);
+            if (e.count > 0) {
+                for (uint32_t b = 0; b < e.count; ++b) {
+                    PT_STAT_ADD(kStatPrimTests, blockTriangles(blocks[e.index + b]));
+                    if (intersectBlock(r, blocks[e.index + b], hit)) found = true;
+                }
+                continue;
+            }
+
+            const Node& node = nodes[e.index];
+            alignas(32) float t_near[N];
+            uint32_t mask = intersectNode(r, node, hit.t, t_near);
+
+            // 插入排序：[first, sp) 内按 t_near 从大到小，栈顶是最近的孩子
+            const int first = sp;
+            while (mask) {
+                int i = simd::firstLane(mask);
+                mask &= mask - 1;
+                StackEntry c{node.child[i], node.count[i], t_near[i]};
+                int k = sp++;
+                while (k > first && stack[k - 1].t_near < c.t_near) {
+                    stack[k] = stack[k - 1];
+                    --k;
+                }
+                stack[k] = c;
+            }
+        }
+        return found;
+    }
+
+    // 遮挡测试：任意命中即返回，不排序
+    bool occluded(const Ray& ray, float t_max) const {
+        if (nodes.empty()) return false;
+
+        RayData r(ray);
+        StackEntry stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = {0, 0, 0.0f};
+
+        while (sp > 0) {
+            const StackEntry e = stack[--sp];
+            PT_STAT_ADD(kStatNodeVisits, 1);
+            if (e.count > 0) {
+                for (uint32_t b = 0; b < e.count; ++b) {
+                    PT_STAT_ADD(kStatPrimTests, blockTriangles(blocks[e.index + b]));
+                    if (occludedBlock(r, blocks[e.index + b], t_max)) return true;
+                }
+                continue;
+            }
+
+            const Node& node = nodes[e.index];
+            alignas(32) float t_near[N];
+            uint32_t mask = intersectNode(r, node, t_max, t_near);
+            while (mask) {
+                int i = simd::firstLane(mask);
+                mask &= mask - 1;
+                stack[sp++] = {node.child[i], node.count[i], t_near[i]};
+            }
+        }
+        return false;
+    }
+
+    // 光线包最近交点：孩子的包围盒逐个对整包做 slab 测试，命中的孩子按第一条活跃射线方向上的远近压栈；
+    // 叶子里的三角形逐个对整包求交。hit 记录各射线的最近图元，packet.t_max 随之缩小，返回命中的射线掩码
+    uint32_t intersectPacket(RayPacket& packet, PacketHit& hit) const {
+        if (nodes.empty() || !packet.active) return 0;
+
+        const int lead = simd::firstLane(packet.active);
+        const float lead_dir[3] = {packet.dir[0][lead], packet.dir[1][lead], packet.dir[2][lead]};
+
+        StackEntry stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = {0, 0, 0.0f};
+
+        uint32_t found = 0;
+        while (sp > 0) {
+            const StackEntry e = stack[--sp];
+            // 统计按射线计，包里每条活跃射线各算一次
+            PT_STAT_ADD(kStatNodeVisits, simd::popcount(packet.active));
+            if (e.count > 0) {
+                for (uint32_t b = 0; b < e.count; ++b) {
+                    PT_STAT_ADD(kStatPrimTests,
+                                uint64_t(blockTriangles(blocks[e.index + b])) * simd::popcount(packet.active));
+                    found |= intersectBlockPacket(packet, blocks[e.index + b], hit);
+                }
+                continue;
+            }
+
+            // t_near 这里存的是孩子中心在 lead_dir 上的投影（乘 2），只用来排序
+            const Node& node = nodes[e.index];
+            const int first = sp;
+            for (int i = 0; i < N; ++i) {
+                if (node.child[i] == kInvalid) continue;
+                float lo[3], hi[3];
+                float key = 0.0f;
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = node.bounds[2 * a][i];
+                    hi[a] = node.bounds[2 * a + 1][i];
+                    key += lead_dir[a] * (lo[a] + hi[a]);
+                }
+                if (!(packet.intersectBox(lo, hi) & packet.active)) continue;
+
+                StackEntry c{node.child[i], node.count[i], key};
+                int k = sp++;
+                while (k > first && stack[k - 1].t_near < c.t_near) {
+                    stack[k] = stack[k - 1];
+                    --k;
+                }
+                stack[k] = c;
+            }
+        }
+        return found;
+    }
+
+    // 光线包遮挡测试：返回被遮挡的射线掩码，被挡住的射线不再参与，全部挡住就提前结束
+    uint32_t occludedPacket(const RayPacket& packet) const {
+        uint32_t remaining = packet.active;
+        if (nodes.empty() || !remaining) return 0;
+
+        StackEntry stack[kStackSize];
+        int sp = 0;
+        stack[sp++] = {0, 0, 0.0f};
+
+        while (sp > 0 && remaining) {
+            const StackEntry e = stack[--sp];
+            PT_STAT_ADD(kStatNodeVisits, simd::popcount(remaining));
+            if (e.count > 0) {
+                for (uint32_t b = 0; b < e.count && remaining; ++b) {
+                    PT_STAT_ADD(kStatPrimTests,
+                                uint64_t(blockTriangles(blocks[e.index + b])) * simd::popcount(remaining));
+                    remaining &= ~occludedBlockPacket(packet, blocks[e.index + b], remaining);
+                }
+                continue;
+            }
+
+            const Node& node = nodes[e.index];
+            for (int i = 0; i < N; ++i) {
+                if (node.child[i] == kInvalid) continue;
+                float lo[3], hi[3];
+                for (int a = 0; a < 3; ++a) {
+                    lo[a] = node.bounds[2 * a][i];
+                    hi[a] = node.bounds[2 * a + 1][i];
+                }
+                if (packet.intersectBox(lo, hi) & remaining) {
+                    stack[sp++] = {node.child[i], node.count[i], 0.0f};
+                }
+            }
+        }
+        return packet.active & ~remaining;
+    }
+
+    // 直接使用已经建好的节点和三角形块（例如从网格缓存里映射出来的）
+    void assign(Buffer<Node> built_nodes, Buffer<TriangleBlock> built_blocks) {
+        nodes = std::move(built_nodes);
+        blocks = std::move(built_blocks);
+    }
+
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t blockCount() const { return blocks.size(); }
+    const Buffer<Node>& getNodes() const { return nodes; }
+    const Buffer<TriangleBlock>& getBlocks() const { return blocks; }
+
+private:
+    using vfloat = simd::vfloat<N>;
+    using vmask = simd::vmask<N>;
+
+    struct StackEntry {
+        uint32_t index;
+        uint32_t count;
+        float t_near;
+    };
+
+    // 每条射线只广播一次
+    struct RayData {
+        vfloat org[3];
+        vfloat dir[3];
+        vfloat inv_dir[3];
+        int near_plane[3];  // 方向为正时近平面是 min，否则是 max
+
+        explicit RayData(const Ray& ray) {
+            const float o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+            const float d[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+            for (int a = 0; a < 3; ++a) {
+                float inv = 1.0f / d[a];
+                org[a] = vfloat::broadcast(o[a]);
+                dir[a] = vfloat::broadcast(d[a]);
+                inv_dir[a] = vfloat::broadcast(inv);
+                near_plane[a] = 2 * a + (inv < 0.0f ? 1 : 0);
+            }
+        }
+    };
+
+    Buffer<Node> nodes;
+    Buffer<TriangleBlock> blocks;
+
+    // 折叠过程中写入的数组，建完再交给成员 nodes / blocks
+    struct BuildOutput {
+        std::vector<Node> nodes;
+        std::vector<TriangleBlock> blocks;
+    };
+
+    // 返回命中孩子的位掩码，t_near 写出各孩子的进入距离
+    // 0 * inf 产生的 NaN 依靠 min/max 的参数顺序丢掉（NaN 时返回第二个参数）
+    static uint32_t intersectNode(const RayData& r, const Node& node, float t_max, float* t_near) {
+        vfloat t0 = vfloat::broadcast(0.0f);
+        vfloat t1 = vfloat::broadcast(t_max);
+        for (int a = 0; a < 3; ++a) {
+            const int n = r.near_plane[a];
+            vfloat lo = (vfloat::load(node.bounds[n]) - r.org[a]) * r.inv_dir[a];
+            vfloat hi = (vfloat::load(node.bounds[n ^ 1]) - r.org[a]) * r.inv_dir[a];
+            t0 = simd::max(lo, t0);
+            t1 = simd::min(hi, t1);
+        }
+        t0.store(t_near);
+        return (t0 <= t1).bits();
+    }
+
+    // 与 intersectTriangle 相同的 Möller–Trumbore，N 个三角形一起算
+    static uint32_t testBlock(const RayData& r, const TriangleBlock& blk, float t_max,
+                              vfloat& t, vfloat& u, vfloat& v) {
+        const vfloat eps = vfloat::broadcast(1e-6f);
+        const vfloat zero = vfloat::broadcast(0.0f);
+        const vfloat one = vfloat::broadcast(1.0f);
+
+        vfloat e1x = vfloat::load(blk.e1[0]), e1y = vfloat::load(blk.e1[1]), e1z = vfloat::load(blk.e1[2]);
+        vfloat e2x = vfloat::load(blk.e2[0]), e2y = vfloat::load(blk.e2[1]), e2z = vfloat::load(blk.e2[2]);
+
+        // pvec = cross(dir, e2)
+        vfloat px = r.dir[1] * e2z - r.dir[2] * e2y;
+        vfloat py = r.dir[2] * e2x - r.dir[0] * e2z;
+        vfloat pz = r.dir[0] * e2y - r.dir[1] * e2x;
+        vfloat det = e1x * px + e1y * py + e1z * pz;
+        vfloat inv_det = one / det;
+
+        vfloat tx = r.org[0] - vfloat::load(blk.v0[0]);
+        vfloat ty = r.org[1] - vfloat::load(blk.v0[1]);
+        vfloat tz = r.org[2] - vfloat::load(blk.v0[2]);
+        u = (tx * px + ty * py + tz * pz) * inv_det;
+
+        // qvec = cross(tvec, e1)
+        vfloat qx = ty * e1z - tz * e1y;
+        vfloat qy = tz * e1x - tx * e1z;
+        vfloat qz = tx * e1y - ty * e1x;
+        v = (r.dir[0] * qx + r.dir[1] * qy + r.dir[2] * qz) * inv_det;
+        t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+
+        vmask m = (simd::abs(det) >= eps) & (u >= zero) & (u <= one) & (v >= zero) &
+                  ((u + v) <= one) & (t >= eps) & (t < vfloat::broadcast(t_max));
+        return m.bits();
+    }
+
+    bool intersectBlock(const RayData& r, const TriangleBlock& blk, PrimitiveHit& hit) const {
+        vfloat t, u, v;
+        uint32_t mask = testBlock(r, blk, hit.t, t, u, v);
+        if (!mask) return false;
+
+        alignas(32) float ts[N], us[N], vs[N];
+        t.store(ts);
+        u.store(us);
+        v.store(vs);
+
+        // 同一块里可能有多个命中，取最近的（距离相同取靠前的）
+        int best = simd::firstLane(mask);
+        mask &= mask - 1;
+        while (mask) {
+            int i = simd::firstLane(mask);
+            mask &= mask - 1;
+            if (ts[i] < ts[best]) best = i;
+        }
+        hit.t = ts[best];
+        hit.prim = blk.prim[best];
+        hit.u = us[best];
+        hit.v = vs[best];
+        return true;
+    }
+
+    static bool occludedBlock(const RayData& r, const TriangleBlock& blk, float t_max) {
+        vfloat t, u, v;
+        return testBlock(r, blk, t_max, t, u, v) != 0;
+    }
+
+    // 块里有效三角形的个数（空槽位在末尾），统计用
+    static uint32_t blockTriangles(const TriangleBlock& blk) {
+        uint32_t n = 0;
+        while (n < static_cast<uint32_t>(N) && blk.prim[n] != kInvalid) ++n;
+        return n;
+    }
+
+    static void blockTriangle(const TriangleBlock& blk, int i, Vector3f& v0, Vector3f& e1, Vector3f& e2) {
+        v0 = Vector3f(blk.v0[0][i], blk.v0[1][i], blk.v0[2][i]);
+        e1 = Vector3f(blk.e1[0][i], blk.e1[1][i], blk.e1[2][i]);
+        e2 = Vector3f(blk.e2[0][i], blk.e2[1][i], blk.e2[2][i]);
+    }
+
+    // 块内三角形按槽位顺序逐个测整包，t_max 严格缩小，所以距离相同时与单条射线一样取靠前的
+    static uint32_t intersectBlockPacket(RayPacket& packet, const TriangleBlock& blk, PacketHit& hit) {
+        uint32_t found = 0;
+        for (int i = 0; i < N && blk.prim[i] != kInvalid; ++i) {
+            Vector3f v0, e1, e2;
+            blockTriangle(blk, i, v0, e1, e2);
+            RayPacket::vfloat t, u, v;
+            uint32_t mask = intersectTrianglePacket(packet, v0, e1, e2, t, u, v);
+            if (!mask) continue;
+
+            alignas(32) float ts[RayPacket::kSize], us[RayPacket::kSize], vs[RayPacket::kSize];
+            t.store(ts);
+            u.store(us);
+            v.store(vs);
+            for (uint32_t m = mask; m; m &= m - 1) {
+                int lane = simd::firstLane(m);
+                packet.t_max[lane] = ts[lane];
+                hit.prim[lane] = blk.prim[i];
+                hit.u[lane] = us[lane];
+                hit.v[lane] = vs[lane];
+            }
+            found |= mask;
+        }
+        return found;
+    }
+
+    static uint32_t occludedBlockPacket(const RayPacket& packet, const TriangleBlock& blk, uint32_t lanes) {
+        uint32_t blocked = 0;
+        for (int i = 0; i < N && blk.prim[i] != kInvalid && (lanes & ~blocked); ++i) {
+            Vector3f v0, e1, e2;
+            blockTriangle(blk, i, v0, e1, e2);
+            RayPacket::vfloat t, u, v;
+            blocked |= intersectTrianglePacket(packet, v0, e1, e2, t, u, v) & lanes;
+        }
+        return blocked;
+    }
+
+    static void setEmpty(Node& node, int slot) {
+        for (int a = 0; a < 3; ++a) {
+            node.bounds[2 * a][slot] = std::numeric_limits<float>::infinity();
+            node.bounds[2 * a + 1][slot] = -std::numeric_limits<float>::infinity();
+        }
+        node.child[slot] = kInvalid;
+        node.count[slot] = 0;
+    }
+
+    // 以二叉节点 b 为根折叠出一个宽节点：反复把面积最大的内部孩子换成它的两个孩子，直到凑满 N 个；
+    // 图元数不超过 N 的子树整个压成叶子，正好填满一个三角形块
+    template <typename TriFn>
+    uint32_t collapse(BuildOutput& out, const BVH& bvh, const std::vector<uint32_t>& subtree,
+                      uint32_t b, TriFn& getTriangle) {
+        const Buffer<BVHNode>& bin = bvh.getNodes();
+        auto leafLike = [&](uint32_t i) {
+            return bin[i].isLeaf() || subtree[i] <= static_cast<uint32_t>(N);
+        };
+
+        uint32_t slots[N];
+        int n = 0;
+        if (leafLike(b)) {
+            slots[n++] = b;
+        } else {
+            slots[n++] = b + 1;
+            slots[n++] = bin[b].offset;
+            while (n < N) {
+                int best = -1;
+                float best_area = -1.0f;
+                for (int k = 0; k < n; ++k) {
+                    if (leafLike(slots[k])) continue;
+                    float area = bin[slots[k]].bounds.surfaceArea();
+                    if (area > best_area) {
+                        best_area = area;
+                        best = k;
+                    }
+                }
+                if (best < 0) break;
+                uint32_t s = slots[best];
+                slots[best] = s + 1;
+                slots[n++] = bin[s].offset;
+            }
+        }
+
+        uint32_t index = static_cast<uint32_t>(out.nodes.size());
+        out.nodes.emplace_back();
+        for (int k = 0; k < N; ++k) setEmpty(out.nodes[index], k);
+
+        for (int k = 0; k < n; ++k) {
+            const AABB& box = bin[slots[k]].bounds;
+            uint32_t child, count;
+            if (leafLike(slots[k])) {
+                child = static_cast<uint32_t>(out.blocks.size());
+                count = emitLeaf(out, bvh, slots[k], getTriangle);
+            } else {
+                child = collapse(out, bvh, subtree, slots[k], getTriangle);
+                count = 0;
+            }
+            // 递归可能让 nodes 重新分配，重新取引用
+            Node& node = out.nodes[index];
+            node.bounds[0][k] = box.min_p.x;
+            node.bounds[1][k] = box.max_p.x;
+            node.bounds[2][k] = box.min_p.y;
+            node.bounds[3][k] = box.max_p.y;
+            node.bounds[4][k] = box.min_p.z;
+            node.bounds[5][k] = box.max_p.z;
+            node.child[k] = child;
+            node.count[k] = count;
+        }
+        return index;
+    }
+
+    // 把子树 b 下的图元按原顺序打包成三角形块，返回块数
+    template <typename TriFn>
+    uint32_t emitLeaf(BuildOutput& out, const BVH& bvh, uint32_t b, TriFn& getTriangle) {
+        const Buffer<BVHNode>& bin = bvh.getNodes();
+        const Buffer<uint32_t>& prims = bvh.primIndices();
+
+        std::vector<uint32_t> leaf_prims;
+        uint32_t stack[BVH::kStackSize];
+        int sp = 0;
+        stack[sp++] = b;
+        while (sp > 0) {
+            const BVHNode& node = bin[stack[--sp]];
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    leaf_prims.push_back(prims[node.offset + i]);
+                }
+            } else {
+                stack[sp++] = node.offset;
+                stack[sp++] = static_cast<uint32_t>(&node - bin.data()) + 1;
+            }
+        }
+
+        uint32_t num_blocks = static_cast<uint32_t>((leaf_prims.size() + N - 1) / N);
+        for (uint32_t k = 0; k < num_blocks; ++k) {
+            TriangleBlock blk;
+            for (int i = 0; i < N; ++i) {
+                size_t p = static_cast<size_t>(k) * N + i;
+                Vector3f v0(0.0f), e1(0.0f), e2(0.0f);
+                blk.prim[i] = kInvalid;
+                if (p < leaf_prims.size()) {
+                    Vector3f v1, v2;
+                    getTriangle(leaf_prims[p], v0, v1, v2);
+                    e1 = v1 - v0;
+                    e2 = v2 - v0;
+                    blk.prim[i] = leaf_prims[p];
+                }
+                blk.v0[0][i] = v0.x; blk.v0[1][i] = v0.y; blk.v0[2][i] = v0.z;
+                blk.e1[0][i] = e1.x; blk.e1[1][i] = e1.y; blk.e1[2][i] = e1.z;
+                blk.e2[0][i] = e2.x; blk.e2[1][i] = e2.y; blk.e2[2][i] = e2.z;
+            }
+            out.blocks.push_back(blk);
+        }
+        return num_blocks;
+    }
+};
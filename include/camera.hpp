@@ -1,6 +1,7 @@
 #pragma once
 
 #include "global.hpp"
+#include "Sampler.hpp"
 
 class Camera {
 public:
@@ -29,6 +30,20 @@ public:
         lower_left_corner = origin - horizontal / 2 - vertical / 2 - w;
     }
 
+    // 一个像素对应的张角（弧度），射线锥的扩散角；纹理 LOD 用
+    float pixelSpreadAngle(int image_height) const {
+        return std::atan(vertical.length() / static_cast<float>(image_height));
+    }
+
+    // 像素 (i, j) 内抖动后的相机射线，(0,0) 为左下角像素；抖动用像素维度
+    Ray generateRay(int i, int j, int image_width, int image_height, Sampler& sampler) const {
+        sampler.setDimension(SampleDims::kPixel);
+        Vector2f jitter = sampler.get2D();
+        float s = (i + jitter.x) / static_cast<float>(image_width);
+        float t = (j + jitter.y) / static_cast<float>(image_height);
+        return generateRay(s, t);
+    }
+
     Ray generateRay(float s, float t) const {
         // s, t 一般是 [0,1] 像素归一化坐标
         Vector3f dir = (lower_left_corner + s * horizontal + t * vertical - origin).normalized();
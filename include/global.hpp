@@ -1,8 +1,8 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
-#include <random>
 #include <limits>
 
 // 常量
@@ -130,10 +130,36 @@ struct Ray {
     }
 };
 
-// 随机数工具：全局使用一个随机引擎
-inline float randFloat() {
-    // 使用 thread_local 避免多线程冲突（目前我们先单线程，可以先这样写）
-    static thread_local std::mt19937 generator(std::random_device{}());
-    static thread_local std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-    return distribution(generator);
-}
+// 基于计数器的随机数：第 k 个数 = hash(key, k)，key 由 (像素, 样本序号, 种子) 决定
+// 状态只有 16 字节，结果与线程、调度顺序无关，同样的输入总是得到同样的图像
+class RNG {
+public:
+    RNG() = default;
+    RNG(uint32_t pixel, uint32_t sample_index, uint32_t seed = 0)
+        : key(mix64((static_cast<uint64_t>(pixel) << 32) | sample_index) ^ mix64(seed + 0x9E3779B97F4A7C15ull)),
+          counter(0) {}
+
+    // 直接跳到第 dim 维（用于让每个路径顶点使用固定的维度）
+    void setDimension(uint32_t dim) { counter = dim; }
+    uint32_t dimension() const { return static_cast<uint32_t>(counter); }
+
+    uint32_t nextUInt() {
+        return static_cast<uint32_t>(mix64(key + (counter++) * 0xD1B54A32D192ED03ull) >> 32);
+    }
+
+    // [0, 1)，取高 24 位保证不会等于 1
+    float nextFloat() {
+        return static_cast<float>(nextUInt() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint64_t key = 0;
+    uint64_t counter = 0;
+
+    // splitmix64 的终结函数
+    static uint64_t mix64(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "global.hpp"
+#include "camera.hpp"
+#include "Scene.hpp"
+#include "MeshTriangle.hpp"
+#include "ThreadPool.hpp"
+#include "Renderer.hpp"
+#include "RayCounters.hpp"
+#include "SceneConfig.hpp"
+
+// 性能基准：对每个自带场景测加载 / 建 BVH 的时间，再在不同线程数下渲染，
+// 报告各类射线每秒的数量和线程扩展性，结果另写一份 JSON 方便逐个提交对比
+// 种子固定，同样的参数每次追踪的射线完全相同
+
+struct BenchOptions {
+    std::vector<std::string> scenes = {"cornell", "veach", "living"};
+    std::vector<int> threads;
+    RenderSettings settings;
+    int repeat = 3;
+    bool use_cache = false;
+    std::string json_path = "bench.json";
+    std::string label;
+};
+
+struct ThreadResult {
+    int threads = 0;
+    double seconds = 0.0;  // repeat 次里最快的一次
+    RayCounts rays;
+};
+
+struct SceneResult {
+    std::string name;
+    bool skipped = false;
+    size_t triangles = 0;
+    double load_ms = 0.0;   // 构造 mesh 到 Scene::commit 结束，含等待贴图解码，不含建 BVH
+    double texture_wait_ms = 0.0;  // 其中等贴图解码的时间（解码没被解析和建 BVH 盖住的部分）
+    double build_ms = 0.0;
+    std::vector<ThreadResult> runs;
+};
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [options]\n"
+              << "  --scenes LIST      comma-separated cornell,veach,living (default all);\n"
+              << "                     scenes whose OBJ is missing are skipped\n"
+              << "  --width N          image width (default 256)\n"
+              << "  --height N         image height (default 256)\n"
+              << "  --spp N            samples per pixel (default 16)\n"
+              << "  --depth N          max path depth (default 5)\n"
+              << "  --threads LIST     comma-separated thread counts (default 1,2,4,... up to the core count)\n"
+              << "  --integrator NAME  path | mis | wavefront (default mis)\n"
+              << "  --packets 0|1      trace camera and first shadow rays in 8-ray packets (default 1)\n"
+              << "  --repeat N         renders per thread count, the fastest is reported (default 3)\n"
+              << "  --seed N           random seed (default 1)\n"
+              << "  --mesh-cache 0|1   load the mesh from <obj>.ptcache (default 0, time the OBJ parse)\n"
+              << "  --label TEXT       free-form tag stored in the JSON (e.g. a commit id)\n"
+              << "  --json FILE        JSON output (default bench.json)\n";
+}
+
+static std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static bool fileExists(const std::string& path) {
+    std::ifstream ifs(path);
+    return static_cast<bool>(ifs);
+}
+
+static SceneResult benchScene(const std::string& name, SceneType type, const BenchOptions& opt) {
+    SceneResult result;
+    result.name = name;
+    SceneConfig cfg = makeSceneConfig(type);
+    if (!fileExists(cfg.obj_path)) {
+        result.skipped = true;
+        return result;
+    }
+
+    const RenderSettings& settings = opt.settings;
+    Camera camera(cfg.eye, cfg.lookat, cfg.up, cfg.vfov,
+                  static_cast<float>(settings.width) / settings.height);
+
+    // 加载和建 BVH 用最多的线程
+    const int max_threads = *std::max_element(opt.threads.begin(), opt.threads.end());
+    ThreadPool load_pool(max_threads);
+    MeshLoadOptions mesh_options;
+    mesh_options.use_cache = opt.use_cache;
+    mesh_options.pool = &load_pool;
+    mesh_options.verbose = false;
+
+    Scene scene;
+    auto t_load = std::chrono::high_resolution_clock::now();
+    MeshTriangle* mesh = new MeshTriangle(cfg.obj_path, mesh_options);
+    // 贴图在后台解码，构造函数不等它；这里先单独等一次，commit 里就不会再等
+    auto t_wait = std::chrono::high_resolution_clock::now();
+    mesh->finishLoading();
+    std::chrono::duration<double, std::milli> wait_ms = std::chrono::high_resolution_clock::now() - t_wait;
+    scene.addObject(mesh);
+    scene.addLightsFromMesh(*mesh);
+    scene.commit();
+    std::chrono::duration<double, std::milli> load_ms = std::chrono::high_resolution_clock::now() - t_load;
+    scene.setPixelSpread(camera.pixelSpreadAngle(settings.height));
+    result.triangles = mesh->faceCount();
+    result.build_ms = mesh->buildMillis();
+    result.load_ms = load_ms.count() - result.build_ms;
+    result.texture_wait_ms = wait_ms.count();
+
+    for (int threads : opt.threads) {
+        ThreadPool pool(threads);
+        ThreadResult run;
+        run.threads = threads;
+        run.seconds = 1e30;
+        for (int r = 0; r < opt.repeat; ++r) {
+            Renderer renderer(scene, camera, settings);
+            std::vector<Vector3f> framebuffer;
+            RayCounters::reset();
+            auto t_start = std::chrono::high_resolution_clock::now();
+            renderer.render(pool, framebuffer);
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - t_start;
+            run.seconds = std::min(run.seconds, elapsed.count());
+            run.rays = RayCounters::total();
+        }
+        result.runs.push_back(run);
+    }
+    return result;
+}
+
+static void printScene(const SceneResult& s) {
+    if (s.skipped) {
+        std::cout << s.name << ": skipped (OBJ not found)\n";
+        return;
+    }
+    std::cout << s.name << ": " << s.triangles << " triangles, load " << s.load_ms
+              << " ms (texture wait " << s.texture_wait_ms << " ms), BVH build " << s.build_ms << " ms\n";
+    std::cout << "  threads   time(s)  camera(M/s)  shadow(M/s)  bounce(M/s)  total(M/s)  speedup  efficiency\n";
+    const ThreadResult& base = s.runs.front();
+    for (const ThreadResult& r : s.runs) {
+        const double speedup = base.seconds / r.seconds;
+        const double efficiency = speedup * base.threads / r.threads;
+        std::cout << std::setw(9) << r.threads << std::setw(10) << r.seconds;
+        for (int t = 0; t < kRayTypeCount; ++t) {
+            std::cout << std::setw(13) << r.rays.n[t] / r.seconds * 1e-6;
+        }
+        std::cout << std::setw(12) << r.rays.total() / r.seconds * 1e-6
+                  << std::setw(9) << speedup << std::setw(11) << 100.0 * efficiency << " %\n";
+    }
+}
+
+static bool writeJson(const std::string& path, const BenchOptions& opt, const std::vector<SceneResult>& results) {
+    std::ofstream ofs(path);
+    if (!ofs) return false;
+    const RenderSettings& s = opt.settings;
+    ofs << std::setprecision(9);
+    ofs << "{\n";
+    ofs << "  \"label\": " << jsonString(opt.label) << ",\n";
+    ofs << "  \"config\": {\"width\": " << s.width << ", \"height\": " << s.height
+        << ", \"spp\": " << s.samples_per_pixel << ", \"max_depth\": " << s.max_depth
+        << ", \"integrator\": " << jsonString(integratorName(s.integrator))
+        << ", \"packets\": " << (s.packets ? "true" : "false")
+        << ", \"seed\": " << s.seed << ", \"repeat\": " << opt.repeat
+        << ", \"mesh_cache\": " << (opt.use_cache ? "true" : "false")
+        << ", \"bvh_width\": " << PT_BVH_WIDTH << "},\n";
+    ofs << "  \"scenes\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult& r = results[i];
+        ofs << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(r.name);
+        if (r.skipped) {
+            ofs << ", \"skipped\": true}";
+            continue;
+        }
+        ofs << ", \"triangles\": " << r.triangles << ", \"load_ms\": " << r.load_ms
+            << ", \"texture_wait_ms\": " << r.texture_wait_ms
+            << ", \"build_ms\": " << r.build_ms << ", \"runs\": [";
+        for (size_t k = 0; k < r.runs.size(); ++k) {
+            const ThreadResult& t = r.runs[k];
+            ofs << (k ? ",\n" : "\n") << "      {\"threads\": " << t.threads << ", \"seconds\": " << t.seconds;
+            for (int type = 0; type < kRayTypeCount; ++type) {
+                ofs << ", \"" << rayTypeName(static_cast<RayType>(type)) << "_rays\": " << t.rays.n[type];
+            }
+            ofs << ", \"rays_per_second\": " << t.rays.total() / t.seconds
+                << ", \"speedup\": " << r.runs.front().seconds / t.seconds << "}";
+        }
+        ofs << "\n    ]}";
+    }
+    ofs << "\n  ]\n}\n";
+    return static_cast<bool>(ofs);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    opt.settings.integrator = IntegratorType::MIS;
+    opt.settings.seed = 1;
+    opt.settings.show_progress = false;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (a + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string str_value = argv[++a];
+        int value = std::atoi(str_value.c_str());
+        if (arg == "--scenes") {
+            opt.scenes = splitList(str_value);
+        } else if (arg == "--width") {
+            opt.settings.width = value;
+        } else if (arg == "--height") {
+            opt.settings.height = value;
+        } else if (arg == "--spp") {
+            opt.settings.samples_per_pixel = value;
+        } else if (arg == "--depth") {
+            opt.settings.max_depth = value;
+        } else if (arg == "--threads") {
+            opt.threads.clear();
+            for (const std::string& t : splitList(str_value)) opt.threads.push_back(std::atoi(t.c_str()));
+        } else if (arg == "--integrator") {
+            if (str_value == "path") {
+                opt.settings.integrator = IntegratorType::Path;
+            } else if (str_value == "mis") {
+                opt.settings.integrator = IntegratorType::MIS;
+            } else if (str_value == "wavefront") {
+                opt.settings.integrator = IntegratorType::Wavefront;
+            } else {
+                std::cerr << "Unknown integrator: " << str_value << "\n";
+                return 1;
+            }
+        } else if (arg == "--packets") {
+            opt.settings.packets = (value != 0);
+        } else if (arg == "--repeat") {
+            opt.repeat = value;
+        } else if (arg == "--seed") {
+            opt.settings.seed = static_cast<uint32_t>(std::strtoul(str_value.c_str(), nullptr, 10));
+        } else if (arg == "--mesh-cache") {
+            opt.use_cache = (value != 0);
+        } else if (arg == "--label") {
+            opt.label = str_value;
+        } else if (arg == "--json") {
+            opt.json_path = str_value;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opt.threads.empty()) {
+        const int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        for (int t = 1; t < cores; t *= 2) opt.threads.push_back(t);
+        opt.threads.push_back(cores);
+    }
+    if (opt.settings.width <= 0 || opt.settings.height <= 0 || opt.settings.samples_per_pixel <= 0 ||
+        opt.repeat <= 0 || opt.scenes.empty() ||
+        *std::min_element(opt.threads.begin(), opt.threads.end()) <= 0) {
+        std::cerr << "Invalid resolution, sample count, repeat count, scene or thread list\n";
+        return 1;
+    }
+
+    std::vector<SceneResult> results;
+    for (const std::string& name : opt.scenes) {
+        SceneType type;
+        if (!parseSceneType(name, type)) {
+            std::cerr << "Unknown scene type: " << name << "\n";
+            return 1;
+        }
+        results.push_back(benchScene(name, type, opt));
+        printScene(results.back());
+    }
+
+    if (!writeJson(opt.json_path, opt, results)) {
+        std::cerr << "Failed to write " << opt.json_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << opt.json_path << "\n";
+    return 0;
+}
@@ -1,7 +1,8 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <string>
+#include <cstdlib>
 #include <thread>
-#include <atomic>
 #include <vector>
 #include <chrono>
 
@@ -11,74 +12,265 @@
 #include "Scene.hpp"
 #include "MeshTriangle.hpp"
 #include "Material.hpp"
+#include "ThreadPool.hpp"
+#include "Renderer.hpp"
+#include "Denoiser.hpp"
+#include "ImageIO.hpp"
+#include "SceneConfig.hpp"
+#include "Stats.hpp"
+
+// 每像素样本数按最大值归一化成灰度图，和输出图像一样从最上面一行开始写（.ppm 或 .png）
+static bool writeSampleMap(const std::string& path, const std::vector<uint32_t>& counts,
+                           int width, int height, ThreadPool* pool) {
+    uint32_t max_count = 1;
+    for (uint32_t c : counts) max_count = std::max(max_count, c);
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    for (int j = height - 1, row = 0; j >= 0; --j, ++row) {
+        for (int i = 0; i < width; ++i) {
+            uint8_t v = static_cast<uint8_t>(255.0f * counts[j * width + i] / max_count + 0.5f);
+            uint8_t* dst = rgb.data() + (static_cast<size_t>(row) * width + i) * 3;
+            dst[0] = dst[1] = dst[2] = v;
+        }
+    }
+    return writeRGB8Image(path, rgb, width, height, pool);
+}
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [cornell|veach|living] [options]\n"
+              << "  --width N          image width (default 256)\n"
+              << "  --height N         image height (default 256)\n"
+              << "  --spp N            samples per pixel (default 16)\n"
+              << "  --depth N          max path depth (default 5)\n"
+              << "  --rr-depth N       start Russian roulette at path vertex N (default 2)\n"
+              << "  --threads N        worker threads (default: hardware concurrency)\n"
+              << "  --tile N           tile size in pixels (default 16)\n"
+              << "  --sample-splits N  split each tile's samples into N tasks (0 = auto)\n"
+              << "  --integrator NAME  path | mis | wavefront (default path);\n"
+              << "                     wavefront is MIS traced in sorted batches\n"
+              << "  --sampler NAME     sobol | random (default sobol)\n"
+              << "  --packets 0|1      trace camera and first shadow rays in 8-ray packets (default 1)\n"
+              << "  --mesh-cache 0|1   load/write the parsed mesh and BVH as <obj>.ptcache (default 1)\n"
+              << "  --bvh NAME         BVH builder: lbvh (fast, for previews) | binned | sweep (best SAH)\n"
+              << "                     (default binned)\n"
+              << "  --seed N           random seed; same seed gives a bit-identical image\n"
+              << "  --adaptive T       adaptive sampling: stop at relative error T (0 = off);\n"
+              << "                     --spp becomes the average per-pixel budget\n"
+              << "  --min-spp N        adaptive: samples per pixel in the first pass\n"
+              << "  --max-spp N        adaptive: per-pixel sample cap\n"
+              << "  --output FILE      write the image to FILE; may be repeated (default output.ppm)\n"
+              << "                     .ppm: binary 8-bit, .png: 8-bit compressed,\n"
+              << "                     .pfm: linear float radiance without tonemapping\n"
+              << "  --sample-map FILE  write the per-pixel sample counts as a grayscale .ppm or .png\n"
+              << "  --stats FILE       write traversal / path statistics as JSON (needs a build\n"
+              << "                     configured with -DPT_ENABLE_STATS=ON)\n"
+              << "  --heatmap 0|1      time every pixel and write false-colour cost maps next to the\n"
+              << "                     first output: <name>_cycles (CPU cycles) and, in a stats build,\n"
+              << "                     <name>_steps (BVH node visits + primitive tests); disables packets\n"
+              << "  --denoise 0|1      run the AOV-guided a-trous denoiser on the image before writing it\n"
+              << "  --aov 0|1          write the first-hit albedo / normal / depth next to the first output:\n"
+              << "                     <name>_albedo, <name>_normal, <name>_depth\n";
+}
+
+// 假彩色：黑 -> 蓝 -> 红 -> 黄 -> 白，t ∈ [0,1]
+static void heatColor(float t, uint8_t* rgb) {
+    static const float stops[5][3] = {
+        {0.0f, 0.0f, 0.0f}, {0.1f, 0.1f, 0.7f}, {0.85f, 0.1f, 0.25f}, {1.0f, 0.8f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+    t = clamp01(t) * 4.0f;
+    const int k = std::min(3, static_cast<int>(t));
+    const float f = t - static_cast<float>(k);
+    for (int c = 0; c < 3; ++c) {
+        rgb[c] = static_cast<uint8_t>(255.0f * (stops[k][c] * (1.0f - f) + stops[k + 1][c] * f) + 0.5f);
+    }
+}
+
+// 每像素开销按第 99 百分位归一化（少数极端像素不至于把其余的都压成黑色）后写成假彩色图；返回该百分位的值
+static bool writeHeatmap(const std::string& path, const std::vector<uint64_t>& values,
+                         int width, int height, ThreadPool* pool, uint64_t& p99) {
+    std::vector<uint64_t> sorted(values);
+    const size_t k = sorted.size() * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    p99 = std::max<uint64_t>(1, sorted[k]);
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    for (int j = height - 1, row = 0; j >= 0; --j, ++row) {
+        for (int i = 0; i < width; ++i) {
+            const float t = static_cast<float>(static_cast<double>(values[j * width + i]) / p99);
+            heatColor(t, rgb.data() + (static_cast<size_t>(row) * width + i) * 3);
+        }
+    }
+    return writeRGB8Image(path, rgb, width, height, pool);
+}
 
-enum class SceneType {
-    CornellBox,
-    VeachMIS,
-    LivingRoom
-};
-
-struct SceneConfig {
-    std::string obj_path;
-    Vector3f    eye;
-    Vector3f    lookat;
-    Vector3f    up;
-    float       vfov;
-};
-
-SceneConfig makeSceneConfig(SceneType type) {
-    SceneConfig cfg{};
-
-    if (type == SceneType::CornellBox) {
-        cfg.obj_path = "../scene/cornell-box/scene.obj";
-
-        cfg.eye    = Vector3f(0.0f, 1.0f, 6.8f);
-        cfg.lookat = Vector3f(0.0f, 1.0f, 5.8f);
-        cfg.up     = Vector3f(0.0f, 1.0f, 0.0f);
-        cfg.vfov   = 19.5f;
-    } else if (type == SceneType::VeachMIS) {
-        cfg.obj_path = "../scene/veach-mis/scene.obj";
-
-        cfg.eye    = Vector3f(28.2792f, 3.5f, 0.000001f);
-        cfg.lookat = Vector3f(27.2792f, 3.5f, 0.000001f);
-        cfg.up     = Vector3f(0.0f,     1.0f, 0.0f);
-        cfg.vfov   = 35.0f; // 简化使用 fovx
-    } else if (type == SceneType::LivingRoom) {
-        cfg.obj_path = "../scene/living-room/scene.obj";
-        cfg.eye    = Vector3f(5.10518f, 0.731065f, -2.31789f);
-        cfg.lookat = Vector3f(4.143388f, 0.805472f, -2.054414f);
-        cfg.up     = Vector3f(0.071763f, 0.997228f, -0.019659f);
-        cfg.vfov   = 90.0f;
-    }
-
-    return cfg;
+// 开销图、AOV 放在第一张输出图旁边：output.ppm -> output_cycles.ppm；.pfm 输出时它们用 .ppm
+static std::string siblingPath(const std::string& output, const std::string& suffix) {
+    const size_t dot = output.find_last_of('.');
+    std::string stem = output.substr(0, dot);
+    std::string ext = output.substr(dot);
+    ImageFormat format;
+    if (imageFormatFromPath(output, format) && format == ImageFormat::PFM) ext = ".ppm";
+    return stem + "_" + suffix + ext;
+}
+
+// AOV 写成可以直接看的图：反照率原样，法线映射到 [0,1]，深度按最大值归一化（没打中的像素为 0）
+static bool writeAovImages(const std::string& output, const std::vector<PixelAov>& aovs,
+                           int width, int height, ThreadPool* pool) {
+    float max_depth = 0.0f;
+    for (const PixelAov& a : aovs) max_depth = std::max(max_depth, a.depth);
+    const float inv_depth = max_depth > 0.0f ? 1.0f / max_depth : 0.0f;
+
+    std::vector<Vector3f> albedo(aovs.size()), normal(aovs.size()), depth(aovs.size());
+    for (size_t p = 0; p < aovs.size(); ++p) {
+        albedo[p] = aovs[p].albedo;
+        normal[p] = aovs[p].normal * 0.5f + Vector3f(0.5f);
+        depth[p] = Vector3f(aovs[p].depth * inv_depth);
+    }
+    const std::pair<const char*, const std::vector<Vector3f>*> images[] = {
+        {"albedo", &albedo}, {"normal", &normal}, {"depth", &depth}};
+    for (const auto& image : images) {
+        const std::string path = siblingPath(output, image.first);
+        if (!writeImage(path, *image.second, width, height, pool)) {
+            std::cerr << "Failed to write " << path << "\n";
+            return false;
+        }
+        std::cerr << "Wrote " << path << "\n";
+    }
+    return true;
 }
 
 int main(int argc, char** argv) {
     SceneType scene_type = SceneType::CornellBox;
-    if (argc > 1) {
-        std::string arg = argv[1];
-        if (arg == "cornell") {
-            scene_type = SceneType::CornellBox;
-        } else if (arg == "veach") {
-            scene_type = SceneType::VeachMIS;
-        } else if (arg == "living") {
-            scene_type = SceneType::LivingRoom;
-        } else {
+    RenderSettings settings;
+    int num_threads = static_cast<int>(std::thread::hardware_concurrency());
+    std::string sample_map_path;
+    std::string stats_path;
+    std::vector<std::string> output_paths;
+    MeshLoadOptions mesh_options;
+    bool denoise = false;
+    bool write_aov = false;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg.rfind("--", 0) == 0) {
+            if (a + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << "\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+            std::string str_value = argv[++a];
+            int value = std::atoi(str_value.c_str());
+            if (arg == "--width") {
+                settings.width = value;
+            } else if (arg == "--height") {
+                settings.height = value;
+            } else if (arg == "--spp") {
+                settings.samples_per_pixel = value;
+            } else if (arg == "--depth") {
+                settings.max_depth = value;
+            } else if (arg == "--rr-depth") {
+                settings.rr_depth = value;
+            } else if (arg == "--threads") {
+                num_threads = value;
+            } else if (arg == "--tile") {
+                settings.tile_size = value;
+            } else if (arg == "--sample-splits") {
+                settings.sample_splits = value;
+            } else if (arg == "--seed") {
+                settings.seed = static_cast<uint32_t>(std::strtoul(str_value.c_str(), nullptr, 10));
+            } else if (arg == "--integrator") {
+                if (str_value == "path") {
+                    settings.integrator = IntegratorType::Path;
+                } else if (str_value == "mis") {
+                    settings.integrator = IntegratorType::MIS;
+                } else if (str_value == "wavefront") {
+                    settings.integrator = IntegratorType::Wavefront;
+                } else {
+                    std::cerr << "Unknown integrator: " << str_value << "\n";
+                    return 1;
+                }
+            } else if (arg == "--packets") {
+                settings.packets = (value != 0);
+            } else if (arg == "--mesh-cache") {
+                mesh_options.use_cache = (value != 0);
+            } else if (arg == "--bvh") {
+                if (str_value == "lbvh") {
+                    mesh_options.bvh_quality = BVHQuality::LBVH;
+                } else if (str_value == "binned") {
+                    mesh_options.bvh_quality = BVHQuality::Binned;
+                } else if (str_value == "sweep") {
+                    mesh_options.bvh_quality = BVHQuality::Sweep;
+                } else {
+                    std::cerr << "Unknown BVH builder: " << str_value << "\n";
+                    return 1;
+                }
+            } else if (arg == "--adaptive") {
+                settings.adaptive_threshold = static_cast<float>(std::atof(str_value.c_str()));
+            } else if (arg == "--min-spp") {
+                settings.min_spp = value;
+            } else if (arg == "--max-spp") {
+                settings.max_spp = value;
+            } else if (arg == "--output") {
+                ImageFormat format;
+                if (!imageFormatFromPath(str_value, format)) {
+                    std::cerr << "Unknown image format: " << str_value << " (use .ppm, .png or .pfm)\n";
+                    return 1;
+                }
+                output_paths.push_back(str_value);
+            } else if (arg == "--sample-map") {
+                ImageFormat format;
+                if (!imageFormatFromPath(str_value, format) || format == ImageFormat::PFM) {
+                    std::cerr << "Sample map must be .ppm or .png: " << str_value << "\n";
+                    return 1;
+                }
+                sample_map_path = str_value;
+            } else if (arg == "--heatmap") {
+                settings.cost_map = (value != 0);
+            } else if (arg == "--denoise") {
+                denoise = (value != 0);
+            } else if (arg == "--aov") {
+                write_aov = (value != 0);
+            } else if (arg == "--stats") {
+                if (!PT_ENABLE_STATS) {
+                    std::cerr << "--stats needs a build with statistics (cmake -DPT_ENABLE_STATS=ON)\n";
+                    return 1;
+                }
+                stats_path = str_value;
+            } else if (arg == "--sampler") {
+                if (str_value == "sobol") {
+                    settings.sampler = SamplerType::Sobol;
+                } else if (str_value == "random") {
+                    settings.sampler = SamplerType::Random;
+                } else {
+                    std::cerr << "Unknown sampler: " << str_value << "\n";
+                    return 1;
+                }
+            } else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (!parseSceneType(arg, scene_type)) {
             std::cerr << "Unknown scene type: " << arg << "\n";
             return 1;
         }
     }
 
+    if (settings.width <= 0 || settings.height <= 0 || settings.samples_per_pixel <= 0) {
+        std::cerr << "Invalid resolution or sample count\n";
+        return 1;
+    }
+    if (num_threads <= 0) num_threads = 4;
+    settings.aov = denoise || write_aov;
+
     SceneConfig cfg = makeSceneConfig(scene_type);
 
-    const int image_width  = 256;
-    const int image_height = 256;
-    const int samples_per_pixel = 16;
-    const int max_depth = 5;
+    const int image_width  = settings.width;
+    const int image_height = settings.height;
+    const int samples_per_pixel = settings.samples_per_pixel;
+    const int max_depth = settings.max_depth;
 
     const int total_pixels = image_width * image_height;
-    const long long total_samples = static_cast<long long>(total_pixels) * samples_per_pixel;
+    const long long sample_budget = static_cast<long long>(total_pixels) * samples_per_pixel;
 
     float aspect_ratio = static_cast<float>(image_width) / image_height;
 
@@ -91,118 +283,153 @@ int main(int argc, char** argv) {
     );
 
     Scene scene;
+    // 线程池先建好，BVH 构建也用它
+    ThreadPool pool(num_threads);
+    mesh_options.pool = &pool;
 
-    MeshTriangle* mesh = new MeshTriangle(cfg.obj_path);
+    MeshTriangle* mesh = new MeshTriangle(cfg.obj_path, mesh_options);
     scene.addObject(mesh);
 
-    // 从 mesh 把发光三角形收集到 Scene 的 lights
-    {
-        std::vector<Object*> lights_from_mesh;
-        const auto& emissive_tris = mesh->getEmissiveTris();
-        for (auto tri : emissive_tris) {
-            lights_from_mesh.push_back(tri);
-        }
-        scene.addLightsFromMesh(lights_from_mesh);
-    }
-
-    std::vector<Vector3f> framebuffer(total_pixels);
-    std::atomic<int> lines_done{0};
+    // 从 mesh 把发光三角形收集到 Scene 的光源表
+    scene.addLightsFromMesh(*mesh);
+    scene.commit();
+    // 贴图 LOD 按相机像素的张角估计射线锥的宽度
+    scene.setPixelSpread(camera.pixelSpreadAngle(image_height));
 
-    auto render_range = [&](int y_start, int y_end) {
-        for (int j = y_start; j < y_end; ++j) {
-            for (int i = 0; i < image_width; ++i) {
-                Vector3f pixel_color(0.0f);
+    std::vector<Vector3f> framebuffer;
 
-                for (int s = 0; s < samples_per_pixel; ++s) {
-                    float u = (i + randFloat()) / static_cast<float>(image_width);
-                    float v = (j + randFloat()) / static_cast<float>(image_height);
-                    Ray r = camera.generateRay(u, v);
-                    pixel_color += scene.castRay(r, max_depth);
-                }
-
-                pixel_color /= static_cast<float>(samples_per_pixel);
-                framebuffer[j * image_width + i] = pixel_color;
-            }
-            lines_done.fetch_add(1, std::memory_order_relaxed);
-        }
-    };
-
-    int num_threads = std::thread::hardware_concurrency();
-    if (num_threads <= 0) num_threads = 4;
-
-    std::cerr << "Scene: ";
-    if (scene_type == SceneType::CornellBox) std::cerr << "CornellBox";
-    else if (scene_type == SceneType::VeachMIS) std::cerr << "VeachMIS";
-    else if (scene_type == SceneType::LivingRoom) std::cerr << "LivingRoom";
-    std::cerr << "\n";
+    std::cerr << "Scene: " << sceneTypeName(scene_type) << "\n";
 
     std::cerr << "Resolution: " << image_width << " x " << image_height
               << ", SPP = " << samples_per_pixel
-              << ", MaxDepth = " << max_depth << "\n";
-    std::cerr << "Total samples (primary rays): " << total_samples << "\n";
-    std::cerr << "Using " << num_threads << " threads.\n";
-
-    auto t_start = std::chrono::high_resolution_clock::now();
-
-    std::vector<std::thread> threads;
-    threads.reserve(num_threads);
-
-    int rows_per_thread = image_height / num_threads;
-    int row_start = 0;
-    for (int t = 0; t < num_threads; ++t) {
-        int row_end = (t == num_threads - 1) ? image_height : (row_start + rows_per_thread);
-        threads.emplace_back(render_range, row_start, row_end);
-        row_start = row_end;
+              << ", MaxDepth = " << max_depth
+              << ", Integrator = " << integratorName(settings.integrator)
+              << ", Sampler = " << samplerName(settings.sampler) << "\n";
+    if (settings.adaptive_threshold > 0.0f) {
+        std::cerr << "Adaptive sampling: threshold " << settings.adaptive_threshold
+                  << ", budget " << sample_budget << " samples\n";
+    } else {
+        std::cerr << "Total samples (primary rays): " << sample_budget << "\n";
     }
+    std::cerr << "Using " << num_threads << " threads, "
+              << settings.tile_size << "x" << settings.tile_size << " tiles.\n";
 
-    // 主线程打印进度
-    while (lines_done.load(std::memory_order_relaxed) < image_height) {
-        int done = lines_done.load(std::memory_order_relaxed);
-        std::cerr << "\rScanlines done: " << done << "/" << image_height << std::flush;
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    }
+    Renderer renderer(scene, camera, settings);
 
-    for (auto& th : threads) {
-        if (th.joinable()) th.join();
-    }
+    auto t_start = std::chrono::high_resolution_clock::now();
+    pool.resetStats();
+    RayCounters::reset();
+    RenderStats::reset();
+
+    renderer.render(pool, framebuffer);
 
     auto t_end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = t_end - t_start;
     double seconds = elapsed.count();
+    const long long total_samples = static_cast<long long>(renderer.totalSamples());
 
-    std::cerr << "\nDone rendering.\n";
+    std::cerr << "Done rendering.\n";
     std::cerr << "Total time: " << seconds << " s\n";
+    if (settings.adaptive_threshold > 0.0f) {
+        std::cerr << "Samples used: " << total_samples << " ("
+                  << static_cast<double>(total_samples) / total_pixels << " per pixel on average)\n";
+    }
     if (seconds > 0.0) {
         double samples_per_sec = static_cast<double>(total_samples) / seconds;
         std::cerr << "Throughput: " << samples_per_sec << " samples/s (primary rays)\n";
     }
+    {
+        const RayCounts rays = RayCounters::total();
+        std::cerr << "Rays traced: " << rays.total();
+        for (int t = 0; t < kRayTypeCount; ++t) {
+            std::cerr << (t == 0 ? " (" : ", ") << rayTypeName(static_cast<RayType>(t)) << " " << rays.n[t];
+        }
+        std::cerr << ")";
+        if (seconds > 0.0) std::cerr << ", " << rays.total() / seconds * 1e-6 << " Mrays/s";
+        std::cerr << "\n";
+#if PT_ENABLE_STATS
+        const StatsSnapshot stats = RenderStats::total();
+        printStatsSummary(std::cerr, stats, rays);
+        if (!stats_path.empty() && !writeStatsJson(stats_path, stats, rays, seconds)) {
+            std::cerr << "Failed to write " << stats_path << "\n";
+            return 1;
+        }
+#endif
+    }
 
-    // 输出 PPM
-    std::ofstream ofs("output.ppm");
-    if (!ofs) {
-        std::cerr << "Failed to open output.ppm for writing\n";
-        return 1;
+    // 每个线程的忙/闲时间，用来确认负载是否均衡
+    {
+        auto worker_stats = pool.stats();
+        double busy_sum = 0.0;
+        for (size_t t = 0; t < worker_stats.size(); ++t) {
+            const auto& ws = worker_stats[t];
+            busy_sum += ws.busy_seconds;
+            std::cerr << "  thread " << t << ": busy " << ws.busy_seconds << " s, idle "
+                      << ws.idle_seconds << " s, tasks " << ws.tasks
+                      << " (stolen " << ws.steals << ")\n";
+        }
+        if (seconds > 0.0 && !worker_stats.empty()) {
+            std::cerr << "Parallel efficiency: "
+                      << 100.0 * busy_sum / (seconds * worker_stats.size()) << " %\n";
+        }
     }
 
-    ofs << "P3\n" << image_width << " " << image_height << "\n255\n";
+    if (denoise) {
+        auto t_denoise = std::chrono::high_resolution_clock::now();
+        Denoiser().denoise(pool, image_width, image_height, framebuffer, renderer.pixelAovs(),
+                           renderer.sampleCounts(), framebuffer);
+        std::chrono::duration<double, std::milli> denoise_ms = std::chrono::high_resolution_clock::now() - t_denoise;
+        std::cerr << "Denoise: " << denoise_ms.count() << " ms\n";
+    }
 
-    for (int j = image_height - 1; j >= 0; --j) {
-        for (int i = 0; i < image_width; ++i) {
-            Vector3f pixel_color = framebuffer[j * image_width + i];
+    // 输出图像；色调映射、PNG 滤波和压缩都在线程池上并行
+    if (output_paths.empty()) output_paths.push_back("output.ppm");
+    for (const std::string& path : output_paths) {
+        auto t_write = std::chrono::high_resolution_clock::now();
+        if (!writeImage(path, framebuffer, image_width, image_height, &pool)) {
+            std::cerr << "Failed to write " << path << "\n";
+            return 1;
+        }
+        std::chrono::duration<double, std::milli> write_ms = std::chrono::high_resolution_clock::now() - t_write;
+        std::cerr << "Wrote " << path << " in " << write_ms.count() << " ms\n";
+    }
 
-            float r_col = std::sqrt(clamp01(pixel_color.x));
-            float g_col = std::sqrt(clamp01(pixel_color.y));
-            float b_col = std::sqrt(clamp01(pixel_color.z));
+    if (!sample_map_path.empty() && !writeSampleMap(sample_map_path, renderer.sampleCounts(),
+                                                    image_width, image_height, &pool)) {
+        std::cerr << "Failed to open " << sample_map_path << " for writing\n";
+        return 1;
+    }
 
-            int ir = static_cast<int>(255.999f * r_col);
-            int ig = static_cast<int>(255.999f * g_col);
-            int ib = static_cast<int>(255.999f * b_col);
+    if (write_aov && !writeAovImages(output_paths.front(), renderer.pixelAovs(), image_width, image_height, &pool)) {
+        return 1;
+    }
 
-            ofs << ir << ' ' << ig << ' ' << ib << '\n';
+    if (settings.cost_map) {
+        const std::vector<PixelCost>& costs = renderer.pixelCosts();
+        std::vector<uint64_t> cycles(costs.size()), steps(costs.size());
+        for (size_t p = 0; p < costs.size(); ++p) {
+            cycles[p] = costs[p].cycles;
+            steps[p] = costs[p].steps;
+        }
+        struct Map {
+            const char* suffix;
+            const char* unit;
+            const std::vector<uint64_t>* values;
+        };
+        std::vector<Map> maps = {{"cycles", "cycles", &cycles}};
+        if (PT_ENABLE_STATS) maps.push_back({"steps", "traversal steps", &steps});
+        for (const Map& m : maps) {
+            const std::string path = siblingPath(output_paths.front(), m.suffix);
+            uint64_t p99 = 0;
+            if (!writeHeatmap(path, *m.values, image_width, image_height, &pool, p99)) {
+                std::cerr << "Failed to write " << path << "\n";
+                return 1;
+            }
+            const uint64_t max_value = *std::max_element(m.values->begin(), m.values->end());
+            std::cerr << "Wrote " << path << " (white = " << p99 << " " << m.unit
+                      << " per pixel at the 99th percentile, max " << max_value << ")\n";
         }
     }
 
-    ofs.close();
-
     return 0;
 }